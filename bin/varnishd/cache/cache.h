@@ -205,6 +205,7 @@ struct http {
 	txt			*hd;
 	unsigned char		*hdf;
 #define HDF_FILTER		(1 << 0)	/* Filtered by Connection */
+	unsigned char		*hdt;		/* Name tags or NULL */
 	uint16_t		shd;		/* Size of hd space */
 	uint16_t		nhd;		/* Next free hd */
 	uint16_t		status;
@@ -233,6 +234,8 @@ struct http_conn {
 	unsigned		maxhdr;
 	struct ws		*ws;
 	txt			rxbuf;
+	const char		*rxscan;
+	unsigned		rxscanned;
 	txt			pipeline;
 	enum body_status	body_status;
 };
@@ -320,6 +323,7 @@ struct pool_task {
 	VTAILQ_ENTRY(pool_task)		list;
 	pool_func_t			*func;
 	void				*priv;
+	double				t_queued;
 };
 
 enum pool_how {
@@ -366,6 +370,15 @@ struct lru {
 #define LRU_MAGIC		0x3fec7bb0
 	VTAILQ_HEAD(,objcore)	lru_head;
 	struct lock		mtx;
+
+	/* Eviction policy, see cache_expire.c */
+	enum lru_policy		policy;
+	VTAILQ_HEAD(,objcore)	lru_prot;	/* SLRU protected segment */
+	unsigned		n_obj;
+	unsigned		n_prot;
+	uint8_t			*sketch;	/* TinyLFU frequency sketch */
+	unsigned		sketch_adds;
+	struct VSC_C_lru	*vsc;
 };
 
 /* Storage -----------------------------------------------------------*/
@@ -419,10 +432,14 @@ struct objcore {
 	unsigned		flags;
 #define OC_F_BUSY		(1<<1)
 #define OC_F_PASS		(1<<2)
+#define OC_F_VARYIDX		(1<<3)		/* vary_hash is valid */
 #define OC_F_LRUDONTMOVE	(1<<4)
 #define OC_F_PRIV		(1<<5)		/* Stevedore private flag */
 #define OC_F_LURK		(3<<6)		/* Ban-lurker-color */
 	unsigned		timer_idx;
+	uint8_t			lru_ref;	/* Used since last LRU pass */
+	uint8_t			lru_seg;	/* LRU segment */
+	uint32_t		vary_hash;	/* See VRY_Hash() */
 	VTAILQ_ENTRY(objcore)	list;
 	VTAILQ_ENTRY(objcore)	lru_list;
 	VTAILQ_ENTRY(objcore)	ban_list;
@@ -550,6 +567,9 @@ struct busyobj {
 	unsigned		do_pass;
 	unsigned		uncacheable;
 
+	/* Our digest has been counted by the TinyLFU sketch */
+	unsigned		lru_counted;
+
 	/* Timeouts */
 	double			connect_timeout;
 	double			first_byte_timeout;
@@ -632,6 +652,8 @@ struct req {
 
 	/* The busy objhead we sleep on */
 	struct objhead		*hash_objhead;
+	/* The object handed to us when we come off the waiting list */
+	struct objcore		*hash_objcore;
 	struct busyobj		*busyobj;
 
 	/* Built Vary string */
@@ -796,7 +818,10 @@ void VBO_Init(void);
 struct busyobj *VBO_GetBusyObj(struct worker *, struct req *);
 void VBO_DerefBusyObj(struct worker *wrk, struct busyobj **busyobj);
 void VBO_Free(struct busyobj **vbo);
-void VBO_extend(const struct busyobj *, ssize_t);
+void VBO_extend(struct busyobj *, ssize_t);
+void VBO_setstate(struct busyobj *, enum busyobj_state_e);
+void VBO_waitstate(struct busyobj *, enum busyobj_state_e);
+ssize_t VBO_waitlen(struct busyobj *, ssize_t);
 
 /* cache_http1_fetch.c [V1F] */
 int V1F_fetch_hdr(struct worker *wrk, struct busyobj *bo, struct req *req);
@@ -835,7 +860,9 @@ void EXP_Inject(struct objcore *oc, struct lru *lru, double when);
 void EXP_Init(void);
 void EXP_Rearm(const struct object *o);
 int EXP_Touch(struct objcore *oc);
+void EXP_Hit(const struct objcore *oc);
 int EXP_NukeOne(struct busyobj *, struct lru *lru);
+void EXP_LruPolicy(struct lru *lru, enum lru_policy policy, const char *ident);
 void EXP_NukeLRU(struct worker *wrk, struct vsl_log *vsl, struct lru *lru);
 
 /* cache_fetch.c */
@@ -877,9 +904,9 @@ enum vgzret_e VGZ_WrwGunzip(struct req *, struct vgz *, const void *ibuf,
 void VGZ_WrwFlush(struct req *, struct vgz *vg);
 
 /* cache_http.c */
-unsigned HTTP_estimate(unsigned nhttp);
+unsigned HTTP_estimate(unsigned nhttp, int tags);
 void HTTP_Copy(struct http *to, const struct http * const fm);
-struct http *HTTP_create(void *p, uint16_t nhttp);
+struct http *HTTP_create(void *p, uint16_t nhttp, int tags);
 const char *http_StatusMessage(unsigned);
 unsigned http_EstimateWS(const struct http *fm, unsigned how, uint16_t *nhd);
 void HTTP_Init(void);
@@ -908,6 +935,7 @@ uint16_t http_GetStatus(const struct http *hp);
 const char *http_GetReq(const struct http *hp);
 int http_HdrIs(const struct http *hp, const char *hdr, const char *val);
 int http_IsHdr(const txt *hh, const char *hdr);
+unsigned char http_HdrTag(const txt *hh);
 enum sess_close http_DoConnection(const struct http *);
 void http_CopyHome(const struct http *hp);
 void http_Unset(struct http *hp, const char *hdr);
@@ -979,6 +1007,7 @@ struct mempool * MPL_New(const char *name, volatile struct poolparam *pp,
 void MPL_Destroy(struct mempool **mpp);
 void *MPL_Get(struct mempool *mpl, unsigned *size);
 void MPL_Free(struct mempool *mpl, void *item);
+void MPL_Fold(void);
 
 /* cache_panic.c */
 void PAN_Init(void);
@@ -993,6 +1022,7 @@ void PipeRequest(struct req *req);
 void Pool_Init(void);
 void Pool_Accept(void);
 void Pool_Work_Thread(void *priv, struct worker *w);
+void Pool_Bind(void *priv);
 int Pool_Task(struct pool *pp, struct pool_task *task, enum pool_how how);
 
 #define WRW_IsReleased(w)	((w)->wrw == NULL)
@@ -1011,7 +1041,8 @@ void SES_Delete(struct sess *sp, enum sess_close reason, double now);
 void SES_Charge(struct worker *, struct req *);
 struct sesspool *SES_NewPool(struct pool *pp, unsigned pool_no);
 void SES_DeletePool(struct sesspool *sp);
-int SES_ScheduleReq(struct req *);
+int SES_ScheduleReq(struct req *, enum pool_how);
+void SES_RunReq(struct worker *, struct req *);
 struct req *SES_GetReq(struct worker *, struct sess *);
 void SES_Handle(struct sess *sp, double now);
 void SES_ReleaseReq(struct req *);
@@ -1020,6 +1051,8 @@ pool_func_t SES_pool_accept_task;
 /* cache_shmlog.c */
 extern struct VSC_C_main *VSC_C_main;
 void VSM_Init(void);
+void VSL_Init(void);
+void VSL_Fold(void);
 void *VSM_Alloc(unsigned size, const char *class, const char *type,
     const char *ident);
 void VSL_Setup(struct vsl_log *vsl, void *ptr, size_t len);
@@ -1030,6 +1063,9 @@ void VSL(enum VSL_tag_e tag, uint32_t vxid, const char *fmt, ...)
 void VSLb(struct vsl_log *, enum VSL_tag_e tag, const char *fmt, ...)
     __printflike(3, 4);
 void VSLbt(struct vsl_log *, enum VSL_tag_e tag, txt t);
+void VSLbs(struct vsl_log *, enum VSL_tag_e tag, const char *s);
+void VSLbu(struct vsl_log *, enum VSL_tag_e tag, const char *pfx, uintmax_t u);
+void VSLbts(struct vsl_log *, enum VSL_tag_e tag, const double *t, unsigned n);
 
 void VSL_Flush(struct vsl_log *, int overflow);
 
@@ -1043,6 +1079,10 @@ void RES_WriteObj(struct req *);
 int VRY_Create(struct busyobj *bo, struct vsb **psb);
 int VRY_Match(struct req *, const uint8_t *vary);
 void VRY_Validate(const uint8_t *vary);
+uint32_t VRY_Hash(const uint8_t *vary);
+uint32_t VRY_ReqHash(const struct req *, const uint8_t *vary);
+int VRY_SameHeaders(const uint8_t *v1, const uint8_t *v2);
+uint8_t *VRY_Dup(const uint8_t *vary);
 void VRY_Prep(struct req *);
 enum vry_finish_flag { KEEP, DISCARD };
 void VRY_Finish(struct req *req, enum vry_finish_flag);
@@ -1117,6 +1157,7 @@ struct object *STV_NewObject(struct busyobj *,
 struct storage *STV_alloc(struct busyobj *, size_t size);
 void STV_trim(struct storage *st, size_t size, int move_ok);
 void STV_free(struct storage *st);
+void STV_Prefetch(const struct storage *st);
 void STV_open(void);
 void STV_close(void);
 void STV_Freestore(struct object *o);
@@ -1129,6 +1170,9 @@ struct vsb *SMS_Makesynth(struct object *obj);
 void SMS_Finish(struct object *obj);
 void SMS_Init(void);
 
+/* storage_file.c */
+void SMF_Init(void);
+
 /* storage_persistent.c */
 void SMP_Init(void);
 void SMP_Ready(void);
@@ -116,19 +116,19 @@ VBO_GetBusyObj(struct worker *wrk, struct req *req)
 	assert(p < bo->end);
 
 	nhttp = (uint16_t)cache_param->http_max_hdr;
-	sz = HTTP_estimate(nhttp);
+	sz = HTTP_estimate(nhttp, 1);
 
-	bo->bereq0 = HTTP_create(p, nhttp);
+	bo->bereq0 = HTTP_create(p, nhttp, 1);
 	p += sz;
 	p = (void*)PRNDUP(p);
 	assert(p < bo->end);
 
-	bo->bereq = HTTP_create(p, nhttp);
+	bo->bereq = HTTP_create(p, nhttp, 1);
 	p += sz;
 	p = (void*)PRNDUP(p);
 	assert(p < bo->end);
 
-	bo->beresp = HTTP_create(p, nhttp);
+	bo->beresp = HTTP_create(p, nhttp, 1);
 	p += sz;
 	p = (void*)PRNDUP(p);
 	assert(p < bo->end);
@@ -136,8 +136,8 @@ VBO_GetBusyObj(struct worker *wrk, struct req *req)
 	sz = cache_param->vsl_buffer;
 	VSL_Setup(bo->vsl, p, sz);
 	bo->vsl->wid = VXID_Get(&wrk->vxid_pool) | VSL_BACKENDMARKER;
-	VSLb(bo->vsl, SLT_Begin, "bereq %u", req->vsl->wid & VSL_IDENTMASK);
-	VSLb(req->vsl, SLT_Link, "bereq %u", bo->vsl->wid & VSL_IDENTMASK);
+	VSLbu(bo->vsl, SLT_Begin, "bereq ", req->vsl->wid & VSL_IDENTMASK);
+	VSLbu(req->vsl, SLT_Link, "bereq ", bo->vsl->wid & VSL_IDENTMASK);
 	p += sz;
 	p = (void*)PRNDUP(p);
 	assert(p < bo->end);
@@ -189,10 +189,13 @@ VBO_DerefBusyObj(struct worker *wrk, struct busyobj **pbo)
 	if (r)
 		return;
 
-	VSLb(bo->vsl, SLT_End, "%s", "");
+	if (bo->vsl->wid != 0)
+		/* Not ended by a finished fetch */
+		VSLbs(bo->vsl, SLT_End, "");
 	VSL_Flush(bo->vsl, 0);
 
-	if (oc != NULL) {
+	/* A pass object lives as long as its busyobj */
+	if (bo->fetch_obj != NULL) {
 		AN(wrk);
 		(void)HSH_Deref(&wrk->stats, NULL, &bo->fetch_obj);
 	}
@@ -211,8 +214,14 @@ VBO_DerefBusyObj(struct worker *wrk, struct busyobj **pbo)
 		VBO_Free(&bo);
 }
 
+/*--------------------------------------------------------------------
+ * The fetch publishes its progress under the busyobj mutex, so that
+ * requests delivering the object while it is fetched can sleep on the
+ * condvar instead of polling.
+ */
+
 void
-VBO_extend(const struct busyobj *bo, ssize_t l)
+VBO_extend(struct busyobj *bo, ssize_t l)
 {
 
 	CHECK_OBJ_NOTNULL(bo, BUSYOBJ_MAGIC);
@@ -220,5 +229,59 @@ VBO_extend(const struct busyobj *bo, ssize_t l)
 	if (l == 0)
 		return;
 	assert(l > 0);
+	Lck_Lock(&bo->mtx);
 	bo->fetch_obj->len += l;
+	AZ(pthread_cond_broadcast(&bo->cond));
+	Lck_Unlock(&bo->mtx);
+}
+
+void
+VBO_setstate(struct busyobj *bo, enum busyobj_state_e next)
+{
+
+	CHECK_OBJ_NOTNULL(bo, BUSYOBJ_MAGIC);
+	Lck_Lock(&bo->mtx);
+	bo->state = next;
+	AZ(pthread_cond_broadcast(&bo->cond));
+	Lck_Unlock(&bo->mtx);
+}
+
+/*--------------------------------------------------------------------
+ * Wait until the fetch has reached at least state 'want'.
+ * BOS_FAILED catches both ways a fetch can end.
+ */
+
+void
+VBO_waitstate(struct busyobj *bo, enum busyobj_state_e want)
+{
+
+	CHECK_OBJ_NOTNULL(bo, BUSYOBJ_MAGIC);
+	Lck_Lock(&bo->mtx);
+	while (bo->state < want)
+		(void)Lck_CondWait(&bo->cond, &bo->mtx, NULL);
+	Lck_Unlock(&bo->mtx);
+}
+
+/*--------------------------------------------------------------------
+ * Wait until the object has more than 'l' bytes or the fetch ended.
+ * Returns the number of bytes which can be delivered, or -1 if the
+ * fetch failed.
+ */
+
+ssize_t
+VBO_waitlen(struct busyobj *bo, ssize_t l)
+{
+	ssize_t rv;
+
+	CHECK_OBJ_NOTNULL(bo, BUSYOBJ_MAGIC);
+	CHECK_OBJ_NOTNULL(bo->fetch_obj, OBJECT_MAGIC);
+	Lck_Lock(&bo->mtx);
+	while (bo->state < BOS_FAILED && bo->fetch_obj->len <= l)
+		(void)Lck_CondWait(&bo->cond, &bo->mtx, NULL);
+	if (bo->state == BOS_FAILED)
+		rv = -1;
+	else
+		rv = bo->fetch_obj->len;
+	Lck_Unlock(&bo->mtx);
+	return (rv);
 }
@@ -158,6 +158,7 @@ cli_debug_sizeof(struct cli *cli, const char * const *av, void *priv)
 	OFOF(struct http, ws);
 	OFOF(struct http, hd);
 	OFOF(struct http, hdf);
+	OFOF(struct http, hdt);
 	OFOF(struct http, shd);
 	OFOF(struct http, nhd);
 	OFOF(struct http, status);
@@ -35,6 +35,14 @@
  *
  * We hold a single object reference for both data structures.
  *
+ * To spread the lock contention, the timers are split over a number of
+ * shards (param: expiry_shards), each with its own lock, binheap and
+ * timer thread.  An objcore is assigned to a shard by hashing its address
+ * so the shard never changes during the lifetime of the objcore.
+ *
+ * Each stevedore can have its own eviction policy (-s ...,lru=policy),
+ * see "LRU eviction policies" below.
+ *
  * An attempted overview:
  *
  *	                        EXP_Ttl()      EXP_Grace()   EXP_Keep()
@@ -52,16 +60,46 @@
 #include "config.h"
 
 #include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
 
 #include "cache.h"
 
 #include "binary_heap.h"
 #include "hash/hash_slinger.h"
+#include "vend.h"
 #include "vtim.h"
 
-static pthread_t exp_thread;
-static struct binheap *exp_heap;
-static struct lock exp_mtx;
+struct exp_shard {
+	unsigned		magic;
+#define EXP_SHARD_MAGIC		0x5f2a1c8d
+	char			name[8];
+	struct lock		mtx;
+	struct binheap		*heap;
+	pthread_t		thread;
+	struct VSC_C_exp	*vsc;
+};
+
+static unsigned exp_nshard;
+static struct exp_shard *exp_shards;
+
+/*--------------------------------------------------------------------
+ * Find the shard an objcore belongs to.
+ *
+ * Objcores are allocated individually, so the low bits of the address
+ * carry little information, use a multiplicative hash to mix them.
+ */
+
+static struct exp_shard *
+exp_shard(const struct objcore *oc)
+{
+	uint32_t u;
+
+	CHECK_OBJ_NOTNULL(oc, OBJCORE_MAGIC);
+	u = (uint32_t)((uintptr_t)oc >> 4);
+	u *= 0x9e3779b1U;
+	return (&exp_shards[(u >> 16) % exp_nshard]);
+}
 
 /*--------------------------------------------------------------------
  * struct exp manipulations
@@ -150,7 +188,7 @@ EXP_Ttl(const struct req *req, const struct object *o)
  */
 
 static int
-update_object_when(const struct object *o)
+update_object_when(const struct exp_shard *sh, const struct object *o)
 {
 	struct objcore *oc;
 	double when, w2;
@@ -158,7 +196,8 @@ update_object_when(const struct object *o)
 	CHECK_OBJ_NOTNULL(o, OBJECT_MAGIC);
 	oc = o->objcore;
 	CHECK_OBJ_NOTNULL(oc, OBJCORE_MAGIC);
-	Lck_AssertHeld(&exp_mtx);
+	CHECK_OBJ_NOTNULL(sh, EXP_SHARD_MAGIC);
+	Lck_AssertHeld(&sh->mtx);
 
 	when = EXP_Keep(NULL, o);
 	w2 = EXP_Grace(NULL, o);
@@ -171,20 +210,263 @@ update_object_when(const struct object *o)
 	return (1);
 }
 
+/*--------------------------------------------------------------------
+ * LRU eviction policies
+ *
+ * classic:  A single LRU list, objects found referenced by EXP_NukeOne()
+ *	get a second chance at the tail of the list (CLOCK).
+ *
+ * slru:  New objects go on lru_head, the probationary segment, and are
+ *	promoted to lru_prot, the protected segment, when EXP_NukeOne()
+ *	finds them referenced.  Victims are taken from probation, so a
+ *	scan cannot flush the objects which have proven their worth.
+ *	The protected segment is limited to param lru_protected percent
+ *	of the objects, its oldest objects are demoted back to probation.
+ *
+ * tinylfu:  As slru, but a count-min sketch of the digests requested
+ *	decides if a new object is worth more than the victim evicted
+ *	for it.  If it is not, it goes first in line for eviction, rather
+ *	than push out more objects.  The sketch is fed from EXP_Hit()
+ *	on every cache hit and from fetches which need to evict, so we
+ *	never have to look at the object itself, which for -sfile may
+ *	not be paged in.
+ *
+ * All of this is protected by the lru->mtx.
+ */
+
+#define LRU_PROBATION		0
+#define LRU_PROTECTED		1
+#define LRU_COLD		2	/* Not inserted yet, goes first */
+
+#define LRU_SKETCH_ROWS		4
+#define LRU_SKETCH_WIDTH	65536
+#define LRU_SKETCH_RESET	(LRU_SKETCH_WIDTH * 10)
+
+#define LRU_STAT(lru, fld)					\
+	do {							\
+		if ((lru)->vsc != NULL)				\
+			(lru)->vsc->fld++;			\
+	} while (0)
+
+static void
+lru_gauge(const struct lru *lru)
+{
+
+	if (lru->vsc == NULL)
+		return;
+	lru->vsc->probation = lru->n_obj - lru->n_prot;
+	lru->vsc->protected = lru->n_prot;
+}
+
+static void
+lru_insert(struct lru *lru, struct objcore *oc)
+{
+
+	Lck_AssertHeld(&lru->mtx);
+	if (oc->lru_seg == LRU_COLD)
+		VTAILQ_INSERT_HEAD(&lru->lru_head, oc, lru_list);
+	else
+		VTAILQ_INSERT_TAIL(&lru->lru_head, oc, lru_list);
+	oc->lru_seg = LRU_PROBATION;
+	lru->n_obj++;
+	lru_gauge(lru);
+}
+
+static void
+lru_remove(struct lru *lru, struct objcore *oc)
+{
+
+	Lck_AssertHeld(&lru->mtx);
+	if (oc->lru_seg == LRU_PROTECTED) {
+		VTAILQ_REMOVE(&lru->lru_prot, oc, lru_list);
+		lru->n_prot--;
+	} else {
+		VTAILQ_REMOVE(&lru->lru_head, oc, lru_list);
+	}
+	oc->lru_seg = LRU_PROBATION;
+	lru->n_obj--;
+	lru_gauge(lru);
+}
+
+/*
+ * Demote the oldest protected objects until the protected segment is
+ * within its quota.  Referenced objects get a second chance here too.
+ */
+
+static void
+lru_balance(struct lru *lru)
+{
+	struct objcore *oc;
+	unsigned max, n;
+
+	Lck_AssertHeld(&lru->mtx);
+	max = (unsigned)(((uint64_t)lru->n_obj *
+	    cache_param->lru_protected) / 100);
+	for (n = 2 * lru->n_prot; lru->n_prot > max && n > 0; n--) {
+		oc = VTAILQ_FIRST(&lru->lru_prot);
+		CHECK_OBJ_NOTNULL(oc, OBJCORE_MAGIC);
+		VTAILQ_REMOVE(&lru->lru_prot, oc, lru_list);
+		if (oc->lru_ref) {
+			oc->lru_ref = 0;
+			VTAILQ_INSERT_TAIL(&lru->lru_prot, oc, lru_list);
+			VSC_C_main->n_lru_moved++;
+			LRU_STAT(lru, moved);
+			continue;
+		}
+		oc->lru_seg = LRU_PROBATION;
+		VTAILQ_INSERT_TAIL(&lru->lru_head, oc, lru_list);
+		lru->n_prot--;
+		LRU_STAT(lru, demoted);
+	}
+	lru_gauge(lru);
+}
+
+/*
+ * The sketch has LRU_SKETCH_ROWS rows of saturating 8 bit counters,
+ * each row indexed by its own 16 bits of the SHA256 digest.  To make
+ * it forget about yesterdays news, all counters are halved once we
+ * have added LRU_SKETCH_RESET entries.  Lost races are of no concern.
+ */
+
+static void
+lru_sketch_add(struct lru *lru, const uint8_t *digest)
+{
+	uint8_t *p;
+	unsigned u;
+
+	AN(lru->sketch);
+	for (u = 0; u < LRU_SKETCH_ROWS; u++) {
+		p = lru->sketch + u * LRU_SKETCH_WIDTH +
+		    vbe16dec(digest + 2 * u);
+		if (*p < 255)
+			(*p)++;
+	}
+	lru->sketch_adds++;
+}
+
+static unsigned
+lru_sketch_freq(const struct lru *lru, const uint8_t *digest)
+{
+	unsigned u, f, r;
+
+	AN(lru->sketch);
+	r = 255;
+	for (u = 0; u < LRU_SKETCH_ROWS; u++) {
+		f = lru->sketch[u * LRU_SKETCH_WIDTH +
+		    vbe16dec(digest + 2 * u)];
+		if (f < r)
+			r = f;
+	}
+	return (r);
+}
+
+static void
+lru_sketch_age(struct lru *lru)
+{
+	unsigned u;
+
+	Lck_AssertHeld(&lru->mtx);
+	for (u = 0; u < LRU_SKETCH_ROWS * LRU_SKETCH_WIDTH; u++)
+		lru->sketch[u] >>= 1;
+	lru->sketch_adds = LRU_SKETCH_RESET / 2;
+}
+
+/*
+ * Is the object being fetched worth more than the victim we are about to
+ * evict for it ?  We have to make the space regardless, but if it isn't,
+ * put it first in line for the next eviction.
+ */
+
+static void
+lru_admit(struct busyobj *bo, struct lru *lru, const struct objcore *victim)
+{
+	struct objcore *oc;
+
+	CHECK_OBJ_NOTNULL(bo, BUSYOBJ_MAGIC);
+	Lck_AssertHeld(&lru->mtx);
+	if (bo->fetch_obj != NULL)
+		oc = bo->fetch_obj->objcore;
+	else
+		oc = bo->fetch_objcore;
+	if (oc == NULL || oc->objhead == NULL || victim->objhead == NULL)
+		return;
+	CHECK_OBJ_NOTNULL(oc, OBJCORE_MAGIC);
+
+	if (!bo->lru_counted) {
+		lru_sketch_add(lru, bo->digest);
+		bo->lru_counted = 1;
+	}
+	if (lru_sketch_freq(lru, bo->digest) >
+	    lru_sketch_freq(lru, victim->objhead->digest)) {
+		LRU_STAT(lru, admitted);
+		return;
+	}
+	LRU_STAT(lru, rejected);
+	if (bo->fetch_obj == NULL) {
+		/* From STV_NewObject(), EXP_Insert() will take the hint */
+		oc->lru_seg = LRU_COLD;
+	} else if (oc_getlru(oc) == lru && oc->timer_idx != BINHEAP_NOIDX &&
+	    oc->lru_seg == LRU_PROBATION) {
+		VTAILQ_REMOVE(&lru->lru_head, oc, lru_list);
+		VTAILQ_INSERT_HEAD(&lru->lru_head, oc, lru_list);
+	}
+}
+
+/*--------------------------------------------------------------------
+ * Set up the eviction policy of a stevedores LRU.  The LRUs of the
+ * -spersistent segments stay classic and have no counters.
+ */
+
+void
+EXP_LruPolicy(struct lru *lru, enum lru_policy policy, const char *ident)
+{
+
+	CHECK_OBJ_NOTNULL(lru, LRU_MAGIC);
+	AN(ident);
+	AZ(lru->n_obj);
+	lru->policy = policy;
+	if (policy == LRU_TINYLFU) {
+		lru->sketch = calloc(LRU_SKETCH_ROWS, LRU_SKETCH_WIDTH);
+		XXXAN(lru->sketch);
+	}
+	lru->vsc = VSM_Alloc(sizeof *lru->vsc, VSC_CLASS, VSC_type_lru, ident);
+	AN(lru->vsc);
+}
+
 /*--------------------------------------------------------------------*/
 
 static void
-exp_insert(struct objcore *oc, struct lru *lru)
+exp_insert(struct exp_shard *sh, struct objcore *oc, struct lru *lru)
 {
+	CHECK_OBJ_NOTNULL(sh, EXP_SHARD_MAGIC);
 	CHECK_OBJ_NOTNULL(oc, OBJCORE_MAGIC);
 	CHECK_OBJ_NOTNULL(lru, LRU_MAGIC);
 
 	Lck_AssertHeld(&lru->mtx);
-	Lck_AssertHeld(&exp_mtx);
+	Lck_AssertHeld(&sh->mtx);
 	assert(oc->timer_idx == BINHEAP_NOIDX);
-	binheap_insert(exp_heap, oc);
+	binheap_insert(sh->heap, oc);
+	assert(oc->timer_idx != BINHEAP_NOIDX);
+	lru_insert(lru, oc);
+	sh->vsc->inserts++;
+	sh->vsc->objects++;
+}
+
+/*--------------------------------------------------------------------
+ * Take an objcore off its shards binheap, the caller handles the LRU.
+ */
+
+static void
+exp_remove(struct exp_shard *sh, struct objcore *oc)
+{
+	CHECK_OBJ_NOTNULL(sh, EXP_SHARD_MAGIC);
+	CHECK_OBJ_NOTNULL(oc, OBJCORE_MAGIC);
+
+	Lck_AssertHeld(&sh->mtx);
 	assert(oc->timer_idx != BINHEAP_NOIDX);
-	VTAILQ_INSERT_TAIL(&lru->lru_head, oc, lru_list);
+	binheap_delete(sh->heap, oc->timer_idx);
+	assert(oc->timer_idx == BINHEAP_NOIDX);
+	sh->vsc->objects--;
 }
 
 /*--------------------------------------------------------------------
@@ -196,15 +478,17 @@ exp_insert(struct objcore *oc, struct lru *lru)
 void
 EXP_Inject(struct objcore *oc, struct lru *lru, double when)
 {
+	struct exp_shard *sh;
 
 	CHECK_OBJ_NOTNULL(oc, OBJCORE_MAGIC);
 	CHECK_OBJ_NOTNULL(lru, LRU_MAGIC);
 
+	sh = exp_shard(oc);
 	Lck_Lock(&lru->mtx);
-	Lck_Lock(&exp_mtx);
+	Lck_Lock(&sh->mtx);
 	oc->timer_when = when;
-	exp_insert(oc, lru);
-	Lck_Unlock(&exp_mtx);
+	exp_insert(sh, oc, lru);
+	Lck_Unlock(&sh->mtx);
 	Lck_Unlock(&lru->mtx);
 }
 
@@ -220,6 +504,7 @@ EXP_Insert(struct object *o)
 {
 	struct objcore *oc;
 	struct lru *lru;
+	struct exp_shard *sh;
 
 	CHECK_OBJ_NOTNULL(o, OBJECT_MAGIC);
 	oc = o->objcore;
@@ -229,29 +514,33 @@ EXP_Insert(struct object *o)
 	assert(o->exp.entered != 0 && !isnan(o->exp.entered));
 	o->last_lru = o->exp.entered;
 
+	sh = exp_shard(oc);
 	lru = oc_getlru(oc);
 	CHECK_OBJ_NOTNULL(lru, LRU_MAGIC);
 	Lck_Lock(&lru->mtx);
-	Lck_Lock(&exp_mtx);
-	(void)update_object_when(o);
-	exp_insert(oc, lru);
-	Lck_Unlock(&exp_mtx);
+	Lck_Lock(&sh->mtx);
+	(void)update_object_when(sh, o);
+	exp_insert(sh, oc, lru);
+	Lck_Unlock(&sh->mtx);
 	Lck_Unlock(&lru->mtx);
 	oc_updatemeta(oc);
 }
 
 /*--------------------------------------------------------------------
- * Object was used, move to tail of LRU list.
+ * Object was used, mark it as referenced.
+ *
+ * This takes no locks and does not touch the LRU lists.  EXP_NukeOne()
+ * and lru_balance() act on the mark when they come across the object,
+ * under lru->mtx: the classic policy moves it to the tail of the LRU
+ * (CLOCK), the segmented ones promote it to the protected segment or
+ * keep it there.  The TinyLFU sketch is fed separately, by EXP_Hit().
  *
- * To avoid the exp_mtx becoming a hotspot, we only attempt to move
- * objects if they have not been moved recently and if the lock is available.
- * This optimization obviously leaves the LRU list imperfectly sorted.
+ * The write is a single byte and we don't care if we lose a race.
  */
 
 int
 EXP_Touch(struct objcore *oc)
 {
-	struct lru *lru;
 
 	CHECK_OBJ_NOTNULL(oc, OBJCORE_MAGIC);
 
@@ -265,25 +554,31 @@ EXP_Touch(struct objcore *oc)
 	if (oc->flags & OC_F_LRUDONTMOVE)
 		return (0);
 
-	lru = oc_getlru(oc);
-	CHECK_OBJ_NOTNULL(lru, LRU_MAGIC);
+	if (!oc->lru_ref)
+		oc->lru_ref = 1;
+	return (1);
+}
 
-	/*
-	 * We only need the LRU lock here.  The locking order is LRU->EXP
-	 * so we can trust the content of the oc->timer_idx without the
-	 * EXP lock.   Since each lru list has its own lock, this should
-	 * reduce contention a fair bit
-	 */
-	if (Lck_Trylock(&lru->mtx))
-		return (0);
+/*--------------------------------------------------------------------
+ * Object was found by a lookup, count it in the TinyLFU sketch.
+ *
+ * Unlike EXP_Touch() this is not rate limited by lru_interval, or
+ * the sketch would only see a fraction of the hits on popular
+ * objects.  It takes no locks, lost races are of no concern.
+ */
 
-	if (oc->timer_idx != BINHEAP_NOIDX) {
-		VTAILQ_REMOVE(&lru->lru_head, oc, lru_list);
-		VTAILQ_INSERT_TAIL(&lru->lru_head, oc, lru_list);
-		VSC_C_main->n_lru_moved++;
-	}
-	Lck_Unlock(&lru->mtx);
-	return (1);
+void
+EXP_Hit(const struct objcore *oc)
+{
+	struct lru *lru;
+
+	CHECK_OBJ_NOTNULL(oc, OBJCORE_MAGIC);
+	lru = oc_getlru(oc);
+	CHECK_OBJ_NOTNULL(lru, LRU_MAGIC);
+	if (lru->sketch == NULL)
+		return;
+	CHECK_OBJ_NOTNULL(oc->objhead, OBJHEAD_MAGIC);
+	lru_sketch_add(lru, oc->objhead->digest);
 }
 
 /*--------------------------------------------------------------------
@@ -300,60 +595,61 @@ EXP_Rearm(const struct object *o)
 {
 	struct objcore *oc;
 	struct lru *lru;
+	struct exp_shard *sh;
 
 	CHECK_OBJ_NOTNULL(o, OBJECT_MAGIC);
 	oc = o->objcore;
 	if (oc == NULL)
 		return;
 	CHECK_OBJ_NOTNULL(oc, OBJCORE_MAGIC);
+	sh = exp_shard(oc);
 	lru = oc_getlru(oc);
 	Lck_Lock(&lru->mtx);
-	Lck_Lock(&exp_mtx);
+	Lck_Lock(&sh->mtx);
 	/*
 	 * The hang-man might have this object of the binheap while
 	 * tending to a timer.  If so, we do not muck with it here.
 	 */
-	if (oc->timer_idx != BINHEAP_NOIDX && update_object_when(o)) {
+	if (oc->timer_idx != BINHEAP_NOIDX && update_object_when(sh, o)) {
 		assert(oc->timer_idx != BINHEAP_NOIDX);
-		binheap_reorder(exp_heap, oc->timer_idx);
+		binheap_reorder(sh->heap, oc->timer_idx);
 		assert(oc->timer_idx != BINHEAP_NOIDX);
+		sh->vsc->rearms++;
 	}
-	Lck_Unlock(&exp_mtx);
+	Lck_Unlock(&sh->mtx);
 	Lck_Unlock(&lru->mtx);
 	oc_updatemeta(oc);
 }
 
 /*--------------------------------------------------------------------
- * This thread monitors the root of the binary heap and whenever an
- * object expires, accounting also for graceability, it is killed.
+ * Take up to 'max' expired objects off the root of the shards binheap
+ * and off their LRU lists, all under a single hold of the shard lock.
+ *
+ * Technically we should drop the sh->mtx, get the lru->mtx, get the
+ * sh->mtx again and then check that the oc is still on the binheap.
+ * We take the shorter route and try to get the lru->mtx and punt if
+ * we fail.  Expired objects typically come from the same stevedore,
+ * so we hang on to the lru->mtx for as long as the LRU stays the same.
  */
 
-static void * __match_proto__(bgthread_t)
-exp_timer(struct worker *wrk, void *priv)
+static unsigned
+exp_harvest(struct exp_shard *sh, double *tp, struct objcore **oca,
+    unsigned max)
 {
 	struct objcore *oc;
-	struct lru *lru;
-	double t;
-	struct object *o;
-	struct vsl_log vsl;
-
-	(void)priv;
-	VSL_Setup(&vsl, NULL, 0);
-	t = VTIM_real();
-	oc = NULL;
-	while (1) {
-		if (oc == NULL) {
-			VSL_Flush(&vsl, 0);
-			WRK_SumStat(wrk);
-			VTIM_sleep(cache_param->expiry_sleep);
-			t = VTIM_real();
-		}
-
-		Lck_Lock(&exp_mtx);
-		oc = binheap_root(exp_heap);
+	struct lru *lru, *lru2;
+	unsigned n;
+
+	CHECK_OBJ_NOTNULL(sh, EXP_SHARD_MAGIC);
+	AN(oca);
+	n = 0;
+	lru = NULL;
+	Lck_Lock(&sh->mtx);
+	while (n < max) {
+		oc = binheap_root(sh->heap);
 		if (oc == NULL) {
-			Lck_Unlock(&exp_mtx);
-			continue;
+			sh->vsc->lag = 0;
+			break;
 		}
 		CHECK_OBJ_NOTNULL(oc, OBJCORE_MAGIC);
 
@@ -361,57 +657,94 @@ exp_timer(struct worker *wrk, void *priv)
 		 * We may have expired so many objects that our timestamp
 		 * got out of date, refresh it and check again.
 		 */
-		if (oc->timer_when > t)
-			t = VTIM_real();
-		if (oc->timer_when > t) {
-			Lck_Unlock(&exp_mtx);
-			oc = NULL;
-			continue;
+		if (oc->timer_when > *tp)
+			*tp = VTIM_real();
+		if (oc->timer_when > *tp) {
+			sh->vsc->lag = 0;
+			break;
 		}
+		sh->vsc->lag = (uint64_t)((*tp - oc->timer_when) * 1e3);
 
 		/* If the object is busy, we have to wait for it */
-		if (oc->flags & OC_F_BUSY) {
-			Lck_Unlock(&exp_mtx);
-			oc = NULL;
-			continue;
+		if (oc->flags & OC_F_BUSY)
+			break;
+
+		lru2 = oc_getlru(oc);
+		CHECK_OBJ_NOTNULL(lru2, LRU_MAGIC);
+		if (lru2 != lru) {
+			if (lru != NULL)
+				Lck_Unlock(&lru->mtx);
+			lru = NULL;
+			if (Lck_Trylock(&lru2->mtx))
+				break;
+			lru = lru2;
 		}
 
-		/*
-		 * It's time...
-		 * Technically we should drop the exp_mtx, get the lru->mtx
-		 * get the exp_mtx again and then check that the oc is still
-		 * on the binheap.  We take the shorter route and try to
-		 * get the lru->mtx and punt if we fail.
-		 */
+		/* Remove from binheap and LRU */
+		exp_remove(sh, oc);
+		lru_remove(lru, oc);
+		sh->vsc->expired++;
+		oca[n++] = oc;
+	}
+	Lck_Unlock(&sh->mtx);
+	if (lru != NULL)
+		Lck_Unlock(&lru->mtx);
+	return (n);
+}
 
-		lru = oc_getlru(oc);
-		CHECK_OBJ_NOTNULL(lru, LRU_MAGIC);
-		if (Lck_Trylock(&lru->mtx)) {
-			Lck_Unlock(&exp_mtx);
-			oc = NULL;
-			continue;
-		}
+/*--------------------------------------------------------------------
+ * This thread monitors the root of the binary heap of its shard and
+ * whenever an object expires, accounting also for graceability, it is
+ * killed.
+ *
+ * Objects are harvested in batches of up to expiry_batch and their
+ * references are released once all the locks have been dropped.
+ */
 
-		/* Remove from binheap */
-		assert(oc->timer_idx != BINHEAP_NOIDX);
-		binheap_delete(exp_heap, oc->timer_idx);
-		assert(oc->timer_idx == BINHEAP_NOIDX);
+static void * __match_proto__(bgthread_t)
+exp_timer(struct worker *wrk, void *priv)
+{
+	struct exp_shard *sh;
+	struct objcore *oc, **oca;
+	double t;
+	struct object *o;
+	struct vsl_log vsl;
+	unsigned u, n, l_oca, batch;
 
-		/* And from LRU */
-		lru = oc_getlru(oc);
-		VTAILQ_REMOVE(&lru->lru_head, oc, lru_list);
+	CAST_OBJ_NOTNULL(sh, priv, EXP_SHARD_MAGIC);
+	VSL_Setup(&vsl, NULL, 0);
+	oca = NULL;
+	l_oca = 0;
+	t = VTIM_real();
+	n = 0;
+	while (1) {
+		if (n == 0) {
+			VSL_Flush(&vsl, 0);
+			WRK_SumStat(wrk);
+			VTIM_sleep(cache_param->expiry_sleep);
+			t = VTIM_real();
+		}
 
-		Lck_Unlock(&exp_mtx);
-		Lck_Unlock(&lru->mtx);
+		batch = cache_param->expiry_batch;
+		if (batch > l_oca) {
+			oca = realloc(oca, batch * sizeof *oca);
+			XXXAN(oca);
+			l_oca = batch;
+		}
+
+		n = exp_harvest(sh, &t, oca, batch);
 
-		VSC_C_main->n_expired++;
+		for (u = 0; u < n; u++) {
+			oc = oca[u];
+			VSC_C_main->n_expired++;
 
-		CHECK_OBJ_NOTNULL(oc->objhead, OBJHEAD_MAGIC);
-		o = oc_getobj(&wrk->stats, oc);
-		VSLb(&vsl, SLT_ExpKill, "%u %.0f",
-		    oc_getxid(&wrk->stats, oc) & VSL_IDENTMASK,
-		    EXP_Ttl(NULL, o) - t);
-		(void)HSH_Deref(&wrk->stats, oc, NULL);
+			CHECK_OBJ_NOTNULL(oc->objhead, OBJHEAD_MAGIC);
+			o = oc_getobj(&wrk->stats, oc);
+			VSLb(&vsl, SLT_ExpKill, "%u %.0f",
+			    oc_getxid(&wrk->stats, oc) & VSL_IDENTMASK,
+			    EXP_Ttl(NULL, o) - t);
+			(void)HSH_Deref(&wrk->stats, oc, NULL);
+		}
 	}
 	NEEDLESS_RETURN(NULL);
 }
@@ -419,20 +752,46 @@ exp_timer(struct worker *wrk, void *priv)
 /*--------------------------------------------------------------------
  * Attempt to make space by nuking the oldest object on the LRU list
  * which isn't in use.
+ *
+ * Objects which have been referenced since we last passed them are
+ * given a second chance: the reference is cleared and they are moved
+ * to the tail of the LRU list, once we are done looking, or promoted
+ * to the protected segment, depending on the eviction policy.
+ *
  * Returns: 1: did, 0: didn't, -1: can't
  */
 
 int
 EXP_NukeOne(struct busyobj *bo, struct lru *lru)
 {
-	struct objcore *oc;
+	struct objcore *oc, *oc2;
+	struct exp_shard *sh;
+	VTAILQ_HEAD(,objcore) moved = VTAILQ_HEAD_INITIALIZER(moved);
 
-	/* Find the first currently unused object on the LRU.  */
+	CHECK_OBJ_NOTNULL(lru, LRU_MAGIC);
 	Lck_Lock(&lru->mtx);
-	Lck_Lock(&exp_mtx);
-	VTAILQ_FOREACH(oc, &lru->lru_head, lru_list) {
+	if (lru->sketch != NULL && lru->sketch_adds >= LRU_SKETCH_RESET)
+		lru_sketch_age(lru);
+
+	/* Find the first currently unused object on probation.  */
+	VTAILQ_FOREACH_SAFE(oc, &lru->lru_head, lru_list, oc2) {
 		CHECK_OBJ_NOTNULL(oc, OBJCORE_MAGIC);
 		assert(oc->timer_idx != BINHEAP_NOIDX);
+		if (oc->lru_ref) {
+			oc->lru_ref = 0;
+			VTAILQ_REMOVE(&lru->lru_head, oc, lru_list);
+			VSC_C_main->n_lru_moved++;
+			if (lru->policy == LRU_CLASSIC) {
+				VTAILQ_INSERT_TAIL(&moved, oc, lru_list);
+				LRU_STAT(lru, moved);
+			} else {
+				oc->lru_seg = LRU_PROTECTED;
+				VTAILQ_INSERT_TAIL(&lru->lru_prot, oc, lru_list);
+				lru->n_prot++;
+				LRU_STAT(lru, promoted);
+			}
+			continue;
+		}
 		/*
 		 * It wont release any space if we cannot release the last
 		 * reference, besides, if somebody else has a reference,
@@ -442,13 +801,49 @@ EXP_NukeOne(struct busyobj *bo, struct lru *lru)
 		if (oc->refcnt == 1 && !(oc->flags & OC_F_BUSY))
 			break;
 	}
+	if (oc == NULL) {
+		/* Nothing to evict on probation, try the protected segment */
+		VTAILQ_FOREACH(oc, &lru->lru_prot, lru_list) {
+			CHECK_OBJ_NOTNULL(oc, OBJCORE_MAGIC);
+			if (oc->refcnt == 1 && !(oc->flags & OC_F_BUSY))
+				break;
+		}
+	}
+	if (oc == NULL) {
+		/*
+		 * Everything was referenced since the last sweep, which
+		 * cleared the marks.  Give the clock a second turn over
+		 * the objects it moved rather than fail the allocation.
+		 */
+		VTAILQ_FOREACH(oc, &moved, lru_list) {
+			CHECK_OBJ_NOTNULL(oc, OBJCORE_MAGIC);
+			if (oc->refcnt == 1 && !(oc->flags & OC_F_BUSY))
+				break;
+		}
+		if (oc != NULL) {
+			VTAILQ_REMOVE(&moved, oc, lru_list);
+			VTAILQ_INSERT_HEAD(&lru->lru_head, oc, lru_list);
+		}
+	}
 	if (oc != NULL) {
-		VTAILQ_REMOVE(&lru->lru_head, oc, lru_list);
-		binheap_delete(exp_heap, oc->timer_idx);
-		assert(oc->timer_idx == BINHEAP_NOIDX);
+		if (lru->sketch != NULL)
+			lru_admit(bo, lru, oc);
+		/*
+		 * We hold the lru->mtx, so the timer thread cannot take
+		 * the oc off the binheap behind our back.
+		 */
+		sh = exp_shard(oc);
+		Lck_Lock(&sh->mtx);
+		lru_remove(lru, oc);
+		exp_remove(sh, oc);
+		sh->vsc->nuked++;
+		Lck_Unlock(&sh->mtx);
 		VSC_C_main->n_lru_nuked++;
+		LRU_STAT(lru, nuked);
 	}
-	Lck_Unlock(&exp_mtx);
+	VTAILQ_CONCAT(&lru->lru_head, &moved, lru_list);
+	if (lru->policy != LRU_CLASSIC)
+		lru_balance(lru);
 	Lck_Unlock(&lru->mtx);
 
 	if (oc == NULL)
@@ -473,6 +868,7 @@ EXP_NukeLRU(struct worker *wrk, struct vsl_log *vsl, struct lru *lru)
 	struct objcore *oc;
 	struct objcore *oc_array[NUKEBUF];
 	struct object *o;
+	struct exp_shard *sh;
 	int i, n;
 	double t;
 
@@ -483,27 +879,29 @@ EXP_NukeLRU(struct worker *wrk, struct vsl_log *vsl, struct lru *lru)
 
 	t = VTIM_real();
 	Lck_Lock(&lru->mtx);
-	while (!VTAILQ_EMPTY(&lru->lru_head)) {
-		Lck_Lock(&exp_mtx);
+	while (lru->n_obj > 0) {
 		n = 0;
 		while (n < NUKEBUF) {
 			oc = VTAILQ_FIRST(&lru->lru_head);
+			if (oc == NULL)
+				oc = VTAILQ_FIRST(&lru->lru_prot);
 			if (oc == NULL)
 				break;
 			CHECK_OBJ_NOTNULL(oc, OBJCORE_MAGIC);
 			assert(oc_getlru(oc) == lru);
 
 			/* Remove from the LRU and binheap */
-			VTAILQ_REMOVE(&lru->lru_head, oc, lru_list);
-			assert(oc->timer_idx != BINHEAP_NOIDX);
-			binheap_delete(exp_heap, oc->timer_idx);
-			assert(oc->timer_idx == BINHEAP_NOIDX);
+			sh = exp_shard(oc);
+			Lck_Lock(&sh->mtx);
+			lru_remove(lru, oc);
+			exp_remove(sh, oc);
+			sh->vsc->nuked++;
+			Lck_Unlock(&sh->mtx);
 
 			oc_array[n++] = oc;
 			VSC_C_main->n_lru_nuked++;
 		}
 		assert(n > 0);
-		Lck_Unlock(&exp_mtx);
 		Lck_Unlock(&lru->mtx);
 
 		for (i = 0; i < n; i++) {
@@ -553,9 +951,23 @@ object_update(void *priv, void *p, unsigned u)
 void
 EXP_Init(void)
 {
-
-	Lck_New(&exp_mtx, lck_exp);
-	exp_heap = binheap_new(NULL, object_cmp, object_update);
-	XXXAN(exp_heap);
-	WRK_BgThread(&exp_thread, "cache-timeout", exp_timer, NULL);
+	struct exp_shard *sh;
+	unsigned u;
+
+	exp_nshard = cache_param->expiry_shards;
+	assert(exp_nshard > 0);
+	exp_shards = calloc(exp_nshard, sizeof *exp_shards);
+	XXXAN(exp_shards);
+	for (u = 0; u < exp_nshard; u++) {
+		sh = &exp_shards[u];
+		sh->magic = EXP_SHARD_MAGIC;
+		bprintf(sh->name, "%u", u);
+		Lck_New(&sh->mtx, lck_exp);
+		sh->heap = binheap_new(sh, object_cmp, object_update);
+		XXXAN(sh->heap);
+		sh->vsc = VSM_Alloc(sizeof *sh->vsc,
+		    VSC_CLASS, VSC_type_exp, sh->name);
+		AN(sh->vsc);
+		WRK_BgThread(&sh->thread, "cache-timeout", exp_timer, sh);
+	}
 }
@@ -360,6 +360,9 @@ vbf_stp_fetch(struct worker *wrk, struct busyobj *bo)
 
 	AZ(bo->fetch_obj);
 	bo->fetch_obj = obj;
+	/* The requester gets its own reference, a pass object it borrows */
+	if (obj->objcore->objhead != NULL)
+		HSH_Ref(obj->objcore);
 
 	if (bo->do_gzip || (bo->is_gzip && !bo->do_gunzip))
 		obj->gziped = 1;
@@ -401,7 +404,7 @@ vbf_stp_fetch(struct worker *wrk, struct busyobj *bo)
 		EXP_Insert(obj);
 		AN(obj->objcore->ban);
 		AZ(obj->ws_o->overflow);
-		HSH_Unbusy(&wrk->stats, obj->objcore);
+		HSH_Unbusy(wrk, obj->objcore);
 	}
 
 	if (bo->vfp == NULL)
@@ -411,14 +414,8 @@ vbf_stp_fetch(struct worker *wrk, struct busyobj *bo)
 
 	assert(bo->refcount >= 1);
 
-	if (obj->objcore->objhead != NULL)
-		HSH_Ref(obj->objcore);
-
-	if (bo->state == BOS_FAILED) {
-		/* handle early failures */
-		(void)HSH_Deref(&wrk->stats, NULL, &obj);
+	if (bo->state == BOS_FAILED)
 		return (F_STP_ABANDON);
-	}
 
 	VBO_DerefBusyObj(wrk, &bo);	// XXX ?
 	return (F_STP_DONE);
@@ -433,7 +430,7 @@ vbf_stp_abandon(struct worker *wrk, struct busyobj *bo)
 	CHECK_OBJ_NOTNULL(wrk, WORKER_MAGIC);
 	CHECK_OBJ_NOTNULL(bo, BUSYOBJ_MAGIC);
 
-	bo->state = BOS_FAILED;
+	VBO_setstate(bo, BOS_FAILED);
 	vbf_release_req(bo);
 	VBO_DerefBusyObj(wrk, &bo);	// XXX ?
 	return (F_STP_DONE);
@@ -59,11 +59,11 @@ VFP_Error2(struct busyobj *bo, const char *error, const char *more)
 	CHECK_OBJ_NOTNULL(bo, BUSYOBJ_MAGIC);
 	if (bo->state == BOS_FETCHING) {
 		if (more == NULL)
-			VSLb(bo->vsl, SLT_FetchError, "%s", error);
+			VSLbs(bo->vsl, SLT_FetchError, error);
 		else
 			VSLb(bo->vsl, SLT_FetchError, "%s: %s", error, more);
 	}
-	bo->state = BOS_FAILED;
+	VBO_setstate(bo, BOS_FAILED);
 	return (-1);
 }
 
@@ -161,8 +161,9 @@ vfp_nop_end(void *priv)
 		STV_free(st);
 		return (0);
 	}
+	/* Streaming readers may be looking at the segment, don't move it */
 	if (st->len < st->space)
-		STV_trim(st, st->len, 1);
+		STV_trim(st, st->len, !bo->do_stream);
 	return (0);
 }
 
@@ -64,6 +64,8 @@
 
 static const struct hash_slinger *hash;
 
+static void hsh_rush(struct dstat *ds, struct objhead *oh);
+
 /*---------------------------------------------------------------------*/
 
 struct objcore *
@@ -149,6 +151,7 @@ HSH_DeleteObjHead(struct dstat *ds, struct objhead *oh)
 
 	AZ(oh->refcnt);
 	assert(VTAILQ_EMPTY(&oh->objcs));
+	free(oh->vary_spec);
 	Lck_Delete(&oh->mtx);
 	ds->n_objecthead--;
 	FREE_OBJ(oh);
@@ -298,6 +301,49 @@ hsh_insert_busyobj(struct worker *wrk, struct objhead *oh)
 	return (oc);
 }
 
+/*---------------------------------------------------------------------
+ * With rush_stream, an objcore which is no longer busy, but still has
+ * its busyobj, can be delivered while the body is fetched.  Hit-for-pass
+ * objects don't need the body at all.
+ */
+
+static int
+hsh_streamable(const struct objcore *oc)
+{
+	const struct busyobj *bo;
+
+	if (!cache_param->rush_stream || oc->flags & OC_F_BUSY)
+		return (0);
+	bo = oc->busyobj;
+	CHECK_OBJ_NOTNULL(bo, BUSYOBJ_MAGIC);
+	if (oc->flags & OC_F_PASS)
+		return (1);
+	return (bo->do_stream && !bo->do_esi && bo->state != BOS_FAILED);
+}
+
+/*---------------------------------------------------------------------
+ * Give a request a reference to the busyobj of the object it found.
+ */
+
+static void
+hsh_attach(struct worker *wrk, struct req *req, struct objcore *oc)
+{
+	struct busyobj *bo;
+
+	Lck_AssertHeld(&oc->objhead->mtx);
+	bo = oc->busyobj;
+	CHECK_OBJ_NOTNULL(bo, BUSYOBJ_MAGIC);
+	CHECK_OBJ_NOTNULL(bo->fetch_obj, OBJECT_MAGIC);
+	if (oc->flags & OC_F_PASS)
+		return;
+	AZ(req->busyobj);
+	/* The objhead mutex protects the refcount, see VBO_DerefBusyObj() */
+	assert(bo->refcount > 0);
+	bo->refcount++;
+	req->busyobj = bo;
+	wrk->stats.busy_stream++;
+}
+
 /*---------------------------------------------------------------------
  */
 
@@ -313,6 +359,8 @@ HSH_Lookup(struct req *req, struct objcore **ocp, struct objcore **bocp,
 	double exp_entered;
 	int busy_found;
 	enum lookup_e retval;
+	uint32_t vary_hash = 0;
+	int vary_done = 0;
 
 	AN(ocp);
 	*ocp = NULL;
@@ -326,6 +374,17 @@ HSH_Lookup(struct req *req, struct objcore **ocp, struct objcore **bocp,
 	AN(req->director);
 	AN(hash);
 
+	if (req->hash_objcore != NULL) {
+		/*
+		 * This req came off the waiting list with the object
+		 * already handed to it, see HSH_Complete().
+		 */
+		AZ(req->hash_objhead);
+		*ocp = req->hash_objcore;
+		req->hash_objcore = NULL;
+		return (HSH_HIT);
+	}
+
 	hsh_prealloc(wrk);
 	if (DO_DEBUG(DBG_HASHEDGE))
 		hsh_testmagic(req->digest);
@@ -368,7 +427,8 @@ HSH_Lookup(struct req *req, struct objcore **ocp, struct objcore **bocp,
 		CHECK_OBJ_NOTNULL(oc, OBJCORE_MAGIC);
 		assert(oc->objhead == oh);
 
-		if (oc->flags & OC_F_BUSY || oc->busyobj != NULL) {
+		if (oc->flags & OC_F_BUSY ||
+		    (oc->busyobj != NULL && !hsh_streamable(oc))) {
 			CHECK_OBJ_ORNULL(oc->busyobj, BUSYOBJ_MAGIC);
 			if (req->hash_ignore_busy)
 				continue;
@@ -382,6 +442,22 @@ HSH_Lookup(struct req *req, struct objcore **ocp, struct objcore **bocp,
 			continue;
 		}
 
+		if (oc->flags & OC_F_VARYIDX) {
+			/* Skip other variants without touching the object */
+			AN(oh->vary_spec);
+			if (!vary_done) {
+				/*
+				 * VRY_Match() builds the predictive vary
+				 * string, which we may not get to call.
+				 */
+				(void)VRY_Match(req, oh->vary_spec);
+				vary_hash = VRY_ReqHash(req, oh->vary_spec);
+				vary_done = 1;
+			}
+			if (oc->vary_hash != vary_hash)
+				continue;
+		}
+
 		o = oc_getobj(&wrk->stats, oc);
 		CHECK_OBJ_NOTNULL(o, OBJECT_MAGIC);
 
@@ -397,6 +473,15 @@ HSH_Lookup(struct req *req, struct objcore **ocp, struct objcore **bocp,
 			assert(oh->refcnt > 1);
 			assert(oc->objhead == oh);
 			oc->refcnt++;
+			if (oc->busyobj != NULL) {
+				hsh_attach(wrk, req, oc);
+				/*
+				 * We will not be done until the fetch is,
+				 * start the next waiters right away.
+				 */
+				if (oh->waitinglist != NULL)
+					hsh_rush(&wrk->stats, oh);
+			}
 			Lck_Unlock(&oh->mtx);
 			assert(HSH_DerefObjHead(&wrk->stats, &oh));
 			if (!cache_param->obj_readonly && o->hits < INT_MAX)
@@ -405,7 +490,7 @@ HSH_Lookup(struct req *req, struct objcore **ocp, struct objcore **bocp,
 			return (HSH_HIT);
 		}
 		if (o->exp.entered > exp_entered &&
-		    !(oc->flags & OC_F_PASS)) {
+		    !(oc->flags & OC_F_PASS) && oc->busyobj == NULL) {
 			/* record the newest object */
 			exp_oc = oc;
 			exp_o = o;
@@ -498,7 +583,7 @@ hsh_rush(struct dstat *ds, struct objhead *oh)
 		AZ(req->wrk);
 		VTAILQ_REMOVE(&wl->list, req, w_list);
 		DSL(DBG_WAITINGLIST, req->vsl->wid, "off waiting list");
-		if (SES_ScheduleReq(req)) {
+		if (SES_ScheduleReq(req, POOL_QUEUE_FRONT)) {
 			/*
 			 * We could not schedule the session, leave the
 			 * rest on the busy list.
@@ -591,32 +676,218 @@ HSH_Drop(struct worker *wrk, struct object **oo)
 }
 
 /*---------------------------------------------------------------------
- * Remove the busyobj from an objcore
+ * Hand a finished object to the requests on the waiting list.
+ *
+ * Under the objhead lock every waiter which would find this object in
+ * HSH_Lookup() trades its objhead reference for a reference to the
+ * object and moves to a batch.  The batch runs as a single pool task,
+ * which gives the requests to idle threads, queues the rest at the
+ * front of the pool as hsh_rush() does and serves the last one itself,
+ * so they neither repeat the lookup nor wait for rush_exponent sized
+ * rounds of wakeups.
+ */
+
+struct hsh_batch {
+	unsigned		magic;
+#define HSH_BATCH_MAGIC		0x2d5a6f91
+	VTAILQ_HEAD(, req)	list;
+	struct pool_task	task;
+};
+
+static void
+hsh_batch_queue(struct worker *wrk, struct req *req, enum pool_how how)
+{
+	struct objcore *oc;
+
+	CHECK_OBJ_NOTNULL(req, REQ_MAGIC);
+	oc = req->hash_objcore;
+	if (how == POOL_NO_QUEUE && !SES_ScheduleReq(req, how))
+		return;
+	if (SES_ScheduleReq(req, POOL_QUEUE_FRONT)) {
+		/* The session is gone, and our reference with it */
+		req->hash_objcore = NULL;
+		if (req->busyobj != NULL)
+			VBO_DerefBusyObj(wrk, &req->busyobj);
+		(void)HSH_Deref(&wrk->stats, oc, NULL);
+	}
+}
+
+static void __match_proto__(pool_func_t)
+hsh_batch_task(struct worker *wrk, void *priv)
+{
+	struct hsh_batch *hb;
+	struct req *req;
+
+	CHECK_OBJ_NOTNULL(wrk, WORKER_MAGIC);
+	CAST_OBJ_NOTNULL(hb, priv, HSH_BATCH_MAGIC);
+	while (1) {
+		req = VTAILQ_FIRST(&hb->list);
+		CHECK_OBJ_NOTNULL(req, REQ_MAGIC);
+		VTAILQ_REMOVE(&hb->list, req, w_list);
+		if (VTAILQ_EMPTY(&hb->list))
+			break;
+		hsh_batch_queue(wrk, req, POOL_NO_QUEUE);
+	}
+	FREE_OBJ(hb);
+	/* The last one is ours */
+	SES_RunReq(wrk, req);
+}
+
+static void
+hsh_coalesce(struct worker *wrk, struct objhead *oh, struct objcore *oc,
+    int stream, struct hsh_batch *hb)
+{
+	struct waitinglist *wl;
+	struct object *o;
+	struct req *req, *req2;
+
+	Lck_AssertHeld(&oh->mtx);
+	wl = oh->waitinglist;
+	CHECK_OBJ_NOTNULL(wl, WAITINGLIST_MAGIC);
+	if (oc->flags & OC_F_BUSY)
+		return;
+	o = oc_getobj(&wrk->stats, oc);
+	CHECK_OBJ_NOTNULL(o, OBJECT_MAGIC);
+	/* Vary needs the lookup, those are left for hsh_rush() */
+	if (o->exp.ttl <= 0. || o->vary != NULL)
+		return;
+	VTAILQ_FOREACH_SAFE(req, &wl->list, w_list, req2) {
+		CHECK_OBJ_NOTNULL(req, REQ_MAGIC);
+		AZ(req->wrk);
+		assert(req->hash_objhead == oh);
+		if (EXP_Ttl(req, o) < req->t_req || BAN_CheckObject(o, req))
+			continue;
+		VTAILQ_REMOVE(&wl->list, req, w_list);
+		VTAILQ_INSERT_TAIL(&hb->list, req, w_list);
+		/* The objcore holds on to the objhead from here */
+		assert(oh->refcnt > 1);
+		oh->refcnt--;
+		req->hash_objhead = NULL;
+		oc->refcnt++;
+		req->hash_objcore = oc;
+		if (stream)
+			hsh_attach(wrk, req, oc);
+		if (!cache_param->obj_readonly && o->hits < INT_MAX)
+			o->hits++;
+		wrk->stats.busy_coalesce++;
+		DSL(DBG_WAITINGLIST, req->vsl->wid, "off waiting list, hit");
+	}
+	if (VTAILQ_EMPTY(&wl->list)) {
+		oh->waitinglist = NULL;
+		FREE_OBJ(wl);
+		wrk->stats.n_waitinglist--;
+	}
+}
+
+static struct hsh_batch *
+hsh_batch_new(const struct objhead *oh)
+{
+	struct hsh_batch *hb;
+
+	/* Unlocked peek, a waiter we miss here is left for hsh_rush() */
+	if (!cache_param->rush_coalesce || oh->waitinglist == NULL)
+		return (NULL);
+	ALLOC_OBJ(hb, HSH_BATCH_MAGIC);
+	XXXAN(hb);
+	VTAILQ_INIT(&hb->list);
+	return (hb);
+}
+
+static void
+hsh_batch_run(struct worker *wrk, struct hsh_batch *hb)
+{
+	struct req *req;
+
+	if (hb == NULL)
+		return;
+	if (VTAILQ_EMPTY(&hb->list)) {
+		FREE_OBJ(hb);
+		return;
+	}
+	hb->task.func = hsh_batch_task;
+	hb->task.priv = hb;
+	if (!Pool_Task(wrk->pool, &hb->task, POOL_QUEUE_FRONT))
+		return;
+	/* No room for the batch, queue the requests one by one */
+	while ((req = VTAILQ_FIRST(&hb->list)) != NULL) {
+		VTAILQ_REMOVE(&hb->list, req, w_list);
+		hsh_batch_queue(wrk, req, POOL_QUEUE_FRONT);
+	}
+	FREE_OBJ(hb);
+}
+
+/*---------------------------------------------------------------------
+ * Remove the busyobj from an objcore.  Called before a successful fetch
+ * is marked BOS_FINISHED, so the requester cannot rush the waiting list
+ * before we get to hand it the object.
  */
 
 void
-HSH_Complete(struct objcore *oc)
+HSH_Complete(struct worker *wrk, struct objcore *oc)
 {
 	struct objhead *oh;
+	struct hsh_batch *hb;
 
+	CHECK_OBJ_NOTNULL(wrk, WORKER_MAGIC);
 	CHECK_OBJ_NOTNULL(oc, OBJCORE_MAGIC);
 	oh = oc->objhead;
 	CHECK_OBJ(oh, OBJHEAD_MAGIC);
 
+	hb = hsh_batch_new(oh);
 	Lck_Lock(&oh->mtx);
+	if (hb != NULL && oh->waitinglist != NULL &&
+	    oc->busyobj != NULL && oc->busyobj->state != BOS_FAILED)
+		hsh_coalesce(wrk, oh, oc, 0, hb);
 	oc->busyobj = NULL;
 	Lck_Unlock(&oh->mtx);
+	hsh_batch_run(wrk, hb);
 }
 
 /*---------------------------------------------------------------------
- * Unbusy an objcore when the object is completely fetched.
+ * Enter a variant in the vary index of its objhead, see VRY_Hash().
+ * If the objhead has nothing indexed on other headers, it takes ours.
+ */
+
+static void
+hsh_vary_index(struct objhead *oh, struct objcore *oc, const uint8_t *vary,
+    uint8_t **spec)
+{
+	struct objcore *oc2;
+	uint8_t *p;
+
+	Lck_AssertHeld(&oh->mtx);
+	AZ(oc->flags & OC_F_VARYIDX);
+	if (oh->vary_spec != NULL && !VRY_SameHeaders(oh->vary_spec, vary)) {
+		VTAILQ_FOREACH(oc2, &oh->objcs, list)
+			if (oc2->flags & OC_F_VARYIDX)
+				return;
+		/* Retire the old headers, our caller frees them */
+		p = oh->vary_spec;
+		oh->vary_spec = *spec;
+		*spec = p;
+	} else if (oh->vary_spec == NULL) {
+		oh->vary_spec = *spec;
+		*spec = NULL;
+	}
+	if (oh->vary_spec == NULL)
+		return;
+	oc->vary_hash = VRY_Hash(vary);
+	oc->flags |= OC_F_VARYIDX;
+}
+
+/*---------------------------------------------------------------------
+ * Unbusy an objcore when the object headers are fetched.
  */
 
 void
-HSH_Unbusy(struct dstat *ds, struct objcore *oc)
+HSH_Unbusy(struct worker *wrk, struct objcore *oc)
 {
 	struct objhead *oh;
+	struct hsh_batch *hb;
+	struct object *o;
+	uint8_t *spec = NULL;
 
+	CHECK_OBJ_NOTNULL(wrk, WORKER_MAGIC);
 	CHECK_OBJ_NOTNULL(oc, OBJCORE_MAGIC);
 	oh = oc->objhead;
 	CHECK_OBJ(oh, OBJHEAD_MAGIC);
@@ -625,6 +896,16 @@ HSH_Unbusy(struct dstat *ds, struct objcore *oc)
 	AN(oc->ban);
 	assert(oh->refcnt > 0);
 
+	/* oc_getobj() would object to the OC_F_BUSY we are about to clear */
+	AN(oc->methods);
+	AN(oc->methods->getobj);
+	o = oc->methods->getobj(&wrk->stats, oc);
+	CHECK_OBJ_NOTNULL(o, OBJECT_MAGIC);
+	/* Unlocked peek, the copy is only needed for the first variant */
+	if (o->vary != NULL && oh->vary_spec == NULL)
+		spec = VRY_Dup(o->vary);
+
+	hb = hsh_batch_new(oh);
 	/* XXX: pretouch neighbors on oh->objcs to prevent page-on under mtx */
 	Lck_Lock(&oh->mtx);
 	assert(oh->refcnt > 0);
@@ -632,9 +913,22 @@ HSH_Unbusy(struct dstat *ds, struct objcore *oc)
 	VTAILQ_REMOVE(&oh->objcs, oc, list);
 	VTAILQ_INSERT_HEAD(&oh->objcs, oc, list);
 	oc->flags &= ~OC_F_BUSY;
-	if (oh->waitinglist != NULL)
-		hsh_rush(ds, oh);
+	if (o->vary != NULL)
+		hsh_vary_index(oh, oc, o->vary, &spec);
+	/*
+	 * Waiters can stream the body from the busyobj, if it allows.
+	 * Otherwise they would only find the busyobj and go back to
+	 * sleep, with rush_coalesce we leave them alone and
+	 * HSH_Complete() will hand them the object.
+	 */
+	if (oh->waitinglist != NULL && hb != NULL) {
+		if (oc->busyobj != NULL && hsh_streamable(oc))
+			hsh_coalesce(wrk, oh, oc, 1, hb);
+	} else if (oh->waitinglist != NULL && !cache_param->rush_coalesce)
+		hsh_rush(&wrk->stats, oh);
 	Lck_Unlock(&oh->mtx);
+	free(spec);
+	hsh_batch_run(wrk, hb);
 }
 
 /*---------------------------------------------------------------------
@@ -32,10 +32,14 @@
 #include "config.h"
 
 #include <stdio.h>
+#include <stdlib.h>
 
 #include "cache.h"
 
+#include "vcli.h"
+#include "vcli_priv.h"
 #include "vct.h"
+#include "vtim.h"
 
 #define HTTPH(a, b, c) char b[] = "*" a ":";
 #include "tbl/http_headers.h"
@@ -94,18 +98,23 @@ http_StatusMessage(unsigned status)
 	return ("Unknown Error");
 }
 
-/*--------------------------------------------------------------------*/
+/*--------------------------------------------------------------------
+ * Without 'tags' there are no name tags (hp->hdt == NULL) and
+ * http_findhdr() scans all the slots.  Stored objects are made this
+ * way, so the tags do not take space from every object in the cache.
+ */
 
 unsigned
-HTTP_estimate(unsigned nhttp)
+HTTP_estimate(unsigned nhttp, int tags)
 {
 
 	/* XXX: We trust the structs to size-aligned as necessary */
-	return (sizeof (struct http) + (sizeof (txt) + 1) * nhttp);
+	return (sizeof (struct http) +
+	    (sizeof (txt) + (tags ? 2 : 1)) * nhttp);
 }
 
 struct http *
-HTTP_create(void *p, uint16_t nhttp)
+HTTP_create(void *p, uint16_t nhttp, int tags)
 {
 	struct http *hp;
 
@@ -114,6 +123,7 @@ HTTP_create(void *p, uint16_t nhttp)
 	hp->hd = (void*)(hp + 1);
 	hp->shd = nhttp;
 	hp->hdf = (void*)(hp->hd + nhttp);
+	hp->hdt = tags ? hp->hdf + nhttp : NULL;
 	return (hp);
 }
 
@@ -136,20 +146,55 @@ http_Teardown(struct http *hp)
 {
 	uint16_t shd;
 	txt *hd;
-	unsigned char *hdf;
+	unsigned char *hdf, *hdt;
 
 	/* XXX: This is not elegant, is it efficient ? */
 	shd = hp->shd;
 	hd = hp->hd;
 	hdf = hp->hdf;
+	hdt = hp->hdt;
 	memset(hp, 0, sizeof *hp);
 	memset(hd, 0, sizeof *hd * shd);
 	memset(hdf, 0, sizeof *hdf * shd);
+	if (hdt != NULL)
+		memset(hdt, 0, sizeof *hdt * shd);
 	hp->magic = HTTP_MAGIC;
 	hp->nhd = HTTP_HDR_FIRST;
 	hp->shd = shd;
 	hp->hd = hd;
 	hp->hdf = hdf;
+	hp->hdt = hdt;
+}
+
+/*--------------------------------------------------------------------
+ * Every header slot has a one byte tag, a case-insensitive hash of the
+ * header name, so http_findhdr() only needs to strncasecmp() the slots
+ * with the right tag.  Whoever writes a header slot sets its tag,
+ * if the struct http has tags.
+ */
+
+static unsigned char
+http_nametag(const char *p, unsigned l)
+{
+	unsigned h = l;
+
+	/* Folds case for letters, and for nothing else found in names */
+	while (l-- > 0)
+		h = h * 33 + (*p++ | 0x20);
+	return ((unsigned char)(h ^ (h >> 8)));
+}
+
+unsigned char
+http_HdrTag(const txt *hh)
+{
+	const char *q;
+
+	if (hh->b == NULL)
+		return (0);
+	q = memchr(hh->b, ':', Tlen(*hh));
+	if (q == NULL)
+		q = hh->e;
+	return (http_nametag(hh->b, q - hh->b));
 }
 
 /*--------------------------------------------------------------------*/
@@ -214,8 +259,11 @@ http_CollectHdr(struct http *hp, const char *hdr)
 				b = e;
 
 			/* Shift remaining headers up one slot */
-			for (v = u; v < hp->nhd - 1; v++)
+			for (v = u; v < hp->nhd - 1; v++) {
 				hp->hd[v] = hp->hd[v + 1];
+				if (hp->hdt != NULL)
+					hp->hdt[v] = hp->hdt[v + 1];
+			}
 			hp->nhd--;
 		}
 
@@ -234,14 +282,44 @@ http_CollectHdr(struct http *hp, const char *hdr)
 }
 
 
-/*--------------------------------------------------------------------*/
+/*--------------------------------------------------------------------
+ * The plain scan, for a struct http without tags and for the benchmark
+ */
+
+static unsigned
+http_findhdr_scan(const struct http *hp, unsigned l, const char *hdr)
+{
+	unsigned u;
+
+	for (u = HTTP_HDR_FIRST; u < hp->nhd; u++) {
+		Tcheck(hp->hd[u]);
+		if (hp->hd[u].e < hp->hd[u].b + l + 1)
+			continue;
+		if (hp->hd[u].b[l] != ':')
+			continue;
+		if (strncasecmp(hdr, hp->hd[u].b, l))
+			continue;
+		return (u);
+	}
+	return (0);
+}
 
 static unsigned
 http_findhdr(const struct http *hp, unsigned l, const char *hdr)
 {
 	unsigned u;
+	unsigned char t;
+	const unsigned char *p;
 
+	if (hp->hdt == NULL)
+		return (http_findhdr_scan(hp, l, hdr));
+	t = http_nametag(hdr, l);
 	for (u = HTTP_HDR_FIRST; u < hp->nhd; u++) {
+		/* memchr(3) scans many tags per instruction in most libcs */
+		p = memchr(hp->hdt + u, t, hp->nhd - u);
+		if (p == NULL)
+			break;
+		u = p - hp->hdt;
 		Tcheck(hp->hd[u]);
 		if (hp->hd[u].e < hp->hd[u].b + l + 1)
 			continue;
@@ -488,6 +566,8 @@ http_SetH(const struct http *to, unsigned n, const char *fm)
 	to->hd[n].b = TRUST_ME(fm);
 	to->hd[n].e = strchr(to->hd[n].b, '\0');
 	to->hdf[n] = 0;
+	if (to->hdt != NULL)
+		to->hdt[n] = http_HdrTag(&to->hd[n]);
 }
 
 static void
@@ -498,6 +578,9 @@ http_linkh(const struct http *to, const struct http *fm, unsigned n)
 	Tcheck(fm->hd[n]);
 	to->hd[n] = fm->hd[n];
 	to->hdf[n] = fm->hdf[n];
+	if (to->hdt != NULL)
+		to->hdt[n] = fm->hdt != NULL ?
+		    fm->hdt[n] : http_HdrTag(&fm->hd[n]);
 }
 
 void
@@ -574,6 +657,9 @@ http_filterfields(struct http *to, const struct http *fm, unsigned how)
 		if (to->nhd < to->shd) {
 			to->hd[to->nhd] = fm->hd[u];
 			to->hdf[to->nhd] = 0;
+			if (to->hdt != NULL)
+				to->hdt[to->nhd] = fm->hdt != NULL ?
+				    fm->hdt[u] : http_HdrTag(&fm->hd[u]);
 			to->nhd++;
 		} else  {
 			VSC_C_main->losthdr++;
@@ -670,7 +756,7 @@ http_SetHeader(struct http *to, const char *hdr)
 	CHECK_OBJ_NOTNULL(to, HTTP_MAGIC);
 	if (to->nhd >= to->shd) {
 		VSC_C_main->losthdr++;
-		VSLb(to->vsl, SLT_LostHeader, "%s", hdr);
+		VSLbs(to->vsl, SLT_LostHeader, hdr);
 		return;
 	}
 	http_SetH(to, to->nhd++, hdr);
@@ -688,7 +774,7 @@ http_PutField(const struct http *to, int field, const char *string)
 	l = strlen(string);
 	p = WS_Alloc(to->ws, l + 1);
 	if (p == NULL) {
-		VSLb(to->vsl, SLT_LostHeader, "%s", string);
+		VSLbs(to->vsl, SLT_LostHeader, string);
 		to->hd[field].b = NULL;
 		to->hd[field].e = NULL;
 		to->hdf[field] = 0;
@@ -698,6 +784,8 @@ http_PutField(const struct http *to, int field, const char *string)
 		to->hd[field].e = p + l;
 		to->hdf[field] = 0;
 	}
+	if (to->hdt != NULL)
+		to->hdt[field] = http_HdrTag(&to->hd[field]);
 }
 
 void
@@ -741,12 +829,15 @@ http_PrintfHeader(struct http *to, const char *fmt, ...)
 	va_end(ap);
 	if (n + 1 >= l || to->nhd >= to->shd) {
 		VSC_C_main->losthdr++;
-		VSLb(to->vsl, SLT_LostHeader, "%s", to->ws->f);
+		VSLbs(to->vsl, SLT_LostHeader, to->ws->f);
 		WS_Release(to->ws, 0);
 	} else {
 		to->hd[to->nhd].b = to->ws->f;
 		to->hd[to->nhd].e = to->ws->f + n;
 		to->hdf[to->nhd] = 0;
+		if (to->hdt != NULL)
+			to->hdt[to->nhd] =
+			    http_HdrTag(&to->hd[to->nhd]);
 		WS_Release(to->ws, n + 1);
 		to->nhd++;
 	}
@@ -766,6 +857,8 @@ http_Unset(struct http *hp, const char *hdr)
 		if (v != u) {
 			memcpy(&hp->hd[v], &hp->hd[u], sizeof *hp->hd);
 			memcpy(&hp->hdf[v], &hp->hdf[u], sizeof *hp->hdf);
+			if (hp->hdt != NULL)
+				hp->hdt[v] = hp->hdt[u];
 		}
 		v++;
 	}
@@ -786,8 +879,135 @@ HTTP_Copy(struct http *to, const struct http * const fm)
 	assert(fm->nhd <= to->shd);
 	memcpy(to->hd, fm->hd, fm->nhd * sizeof *to->hd);
 	memcpy(to->hdf, fm->hdf, fm->nhd * sizeof *to->hdf);
+	AN(to->hdt);
+	AN(fm->hdt);
+	memcpy(to->hdt, fm->hdt, fm->nhd * sizeof *to->hdt);
 }
 
+/*--------------------------------------------------------------------
+ * Microbenchmark:  header lookups on a typical request, with the name
+ * tags and with the plain scan http_findhdr() used to do.
+ */
+
+static const char * const http_bench_hdrs[] = {
+	"Host: www.example.com",
+	"User-Agent: Mozilla/5.0 (X11; Linux x86_64; rv:24.0) Gecko/20100101",
+	"Accept: text/html,application/xhtml+xml,application/xml;q=0.9,*/*",
+	"Accept-Language: en-US,en;q=0.5",
+	"Accept-Encoding: gzip, deflate",
+	"Referer: http://www.example.com/index.html",
+	"Cookie: __utma=1.2.3.4; session=0123456789abcdef",
+	"Connection: keep-alive",
+	"Cache-Control: max-age=0",
+	"If-Modified-Since: Tue, 15 Oct 2013 08:12:31 GMT",
+	"If-None-Match: \"3e86-410-3596fbbc\"",
+	"X-Forwarded-For: 192.0.2.1",
+	"X-Forwarded-Proto: https",
+	"X-Requested-With: XMLHttpRequest",
+	"DNT: 1",
+	"Pragma: no-cache",
+	"Via: 1.1 proxy.example.com",
+	"Origin: http://www.example.com",
+	"Upgrade-Insecure-Requests: 1",
+	"X-Real-IP: 192.0.2.1",
+};
+
+/* What vcl_recv and friends typically ask for, present or not */
+static const char * const http_bench_lookups[] = {
+	H_Host, H_Cookie, H_Accept_Encoding, H_Authorization,
+	H_Cache_Control, H_If_None_Match, H_If_Modified_Since, H_Range,
+	H_Expect, H_Content_Length, H_Transfer_Encoding, H_Connection,
+	H_Pragma, H_User_Agent, H_Via, H_Upgrade,
+};
+
+static double
+http_bench_run(const struct http *hp, unsigned nlook, int scan)
+{
+	unsigned u, v, n = 0;
+	const char *h;
+	double t0;
+
+	t0 = VTIM_mono();
+	for (u = 0; u < nlook; u++) {
+		h = http_bench_lookups[u % (sizeof http_bench_lookups /
+		    sizeof http_bench_lookups[0])];
+		if (scan)
+			v = http_findhdr_scan(hp, h[0] - 1, h + 1);
+		else
+			v = http_findhdr(hp, h[0] - 1, h + 1);
+		n += v;
+	}
+	t0 = VTIM_mono() - t0;
+	/* Keep the compiler from optimizing the lookups away */
+	assert(n != 1);
+	return (t0);
+}
+
+static void
+http_bench(struct cli *cli, const char * const *av, void *priv)
+{
+	struct http *hp;
+	unsigned u, v, nhdr = 30, nlook = 10000000;
+	char *extra;
+	void *p;
+	double ts, tt;
+
+	(void)priv;
+	if (av[2] != NULL) {
+		nhdr = strtoul(av[2], NULL, 0);
+		if (av[3] != NULL)
+			nlook = strtoul(av[3], NULL, 0);
+	}
+	if (nhdr < 1 || nhdr > 1000 || nlook < 1) {
+		VCLI_Out(cli, "Need 1...1000 headers and at least one lookup");
+		VCLI_SetResult(cli, CLIS_PARAM);
+		return;
+	}
+	p = malloc(HTTP_estimate(nhdr + HTTP_HDR_FIRST, 1));
+	AN(p);
+	hp = HTTP_create(p, nhdr + HTTP_HDR_FIRST, 1);
+	http_Teardown(hp);
+	extra = calloc(nhdr, 32);
+	AN(extra);
+	for (u = 0; u < nhdr; u++) {
+		v = sizeof http_bench_hdrs / sizeof http_bench_hdrs[0];
+		if (u < v) {
+			http_SetHeader(hp, http_bench_hdrs[u]);
+			continue;
+		}
+		/* Pad with application headers, which nobody asks for */
+		assert(snprintf(extra + u * 32, 32,
+		    "X-App-Header-%u: %u", u - v, u) < 32);
+		http_SetHeader(hp, extra + u * 32);
+	}
+	assert(hp->nhd == nhdr + HTTP_HDR_FIRST);
+
+	/* The two had better agree */
+	for (u = 0; u < sizeof http_bench_lookups /
+	    sizeof http_bench_lookups[0]; u++)
+		assert(http_findhdr(hp, http_bench_lookups[u][0] - 1,
+		    http_bench_lookups[u] + 1) ==
+		    http_findhdr_scan(hp, http_bench_lookups[u][0] - 1,
+		    http_bench_lookups[u] + 1));
+
+	ts = http_bench_run(hp, nlook, 1);
+	tt = http_bench_run(hp, nlook, 0);
+
+	free(extra);
+	free(p);
+
+	VCLI_Out(cli, "%u headers, %u lookups\n", nhdr, nlook);
+	VCLI_Out(cli, "scan: %.1f ns/lookup\n", 1e9 * ts / nlook);
+	VCLI_Out(cli, "tags: %.1f ns/lookup", 1e9 * tt / nlook);
+}
+
+static struct cli_proto http_cmds[] = {
+	{ "debug.http_bench", "debug.http_bench [headers [lookups]]",
+		"\tBenchmark header lookups on a typical request\n",
+		0, 2, "d", http_bench },
+	{ NULL }
+};
+
 /*--------------------------------------------------------------------*/
 
 void
@@ -797,4 +1017,5 @@ HTTP_Init(void)
 #define HTTPH(a, b, c) b[0] = (char)strlen(b + 1);
 #include "tbl/http_headers.h"
 #undef HTTPH
+	CLI_AddFuncs(http_cmds);
 }
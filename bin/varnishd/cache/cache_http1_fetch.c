@@ -337,7 +337,7 @@ V1F_fetch_body(struct worker *wrk, struct busyobj *bo)
 	AZ(bo->vgz_rx);
 	AZ(VTAILQ_FIRST(&obj->store));
 
-	bo->state = BOS_FETCHING;
+	VBO_setstate(bo, BOS_FETCHING);
 
 	/* XXX: pick up estimate from objdr ? */
 	cl = 0;
@@ -419,7 +419,7 @@ V1F_fetch_body(struct worker *wrk, struct busyobj *bo)
 	} else {
 		assert(bo->state == BOS_FETCHING);
 
-		VSLb(bo->vsl, SLT_Length, "%zd", obj->len);
+		VSLbu(bo->vsl, SLT_Length, NULL, (uintmax_t)obj->len);
 
 		{
 		/* Sanity check fetch methods accounting */
@@ -437,15 +437,25 @@ V1F_fetch_body(struct worker *wrk, struct busyobj *bo)
 		}
 
 		if (mklen > 0) {
+			/* Streaming requests copy the headers under the lock */
+			Lck_Lock(&bo->mtx);
 			http_Unset(obj->http, H_Content_Length);
 			http_PrintfHeader(obj->http,
 			    "Content-Length: %zd", obj->len);
+			Lck_Unlock(&bo->mtx);
 		}
-
-		/* XXX: Atomic assignment, needs volatile/membar ? */
-		bo->state = BOS_FINISHED;
 	}
 	if (obj->objcore->objhead != NULL)
-		HSH_Complete(obj->objcore);
+		HSH_Complete(wrk, obj->objcore);
+	if (bo->state != BOS_FAILED) {
+		/*
+		 * The requester finishes its transaction as soon as it sees
+		 * BOS_FINISHED, end ours first so it is not logged after.
+		 */
+		VSLbs(bo->vsl, SLT_End, "");
+		VSL_Flush(bo->vsl, 0);
+		bo->vsl->wid = 0;
+		VBO_setstate(bo, BOS_FINISHED);
+	}
 	bo->stats = NULL;
 }
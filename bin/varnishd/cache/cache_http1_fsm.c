@@ -282,6 +282,7 @@ http1_dissect(struct worker *wrk, struct req *req)
 	CHECK_OBJ_NOTNULL(req, REQ_MAGIC);
 
 	memset(&req->h1, 0, sizeof req->h1);
+	wrk->stats.sess_rxscan += req->htc->rxscanned;
 
 	/*
 	 * Cache_req_fsm zeros the vxid once a requests is processed.
@@ -289,7 +290,7 @@ http1_dissect(struct worker *wrk, struct req *req)
 	 */
 	if (req->vsl->wid == 0) {
 		req->vsl->wid = VXID_Get(&wrk->vxid_pool) | VSL_CLIENTMARKER;
-		VSLb(req->vsl, SLT_Begin, "req %u",
+		VSLbu(req->vsl, SLT_Begin, "req ",
 		    req->sp->vxid & VSL_IDENTMASK);
 		VSL(SLT_Link, req->sp->vxid, "req %u",
 		    req->vsl->wid & VSL_IDENTMASK);
@@ -378,8 +379,16 @@ HTTP1_Session(struct worker *wrk, struct req *req)
 	 * Return from waitinglist. Check to see if the remote has left.
 	 */
 	if (req->req_step == R_STP_LOOKUP && VTCP_check_hup(sp->fd)) {
-		AN(req->hash_objhead);
-		(void)HSH_DerefObjHead(&wrk->stats, &req->hash_objhead);
+		if (req->hash_objcore != NULL) {
+			if (req->busyobj != NULL)
+				VBO_DerefBusyObj(wrk, &req->busyobj);
+			(void)HSH_Deref(&wrk->stats, req->hash_objcore, NULL);
+			req->hash_objcore = NULL;
+		} else {
+			AN(req->hash_objhead);
+			(void)HSH_DerefObjHead(&wrk->stats,
+			    &req->hash_objhead);
+		}
 		AZ(req->hash_objhead);
 		SES_Close(sp, SC_REM_CLOSE);
 		sdr = http1_cleanup(sp, wrk, req);
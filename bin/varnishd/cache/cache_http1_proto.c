@@ -65,6 +65,8 @@ HTTP1_Init(struct http_conn *htc, struct ws *ws, int fd, struct vsl_log *vsl,
 	htc->rxbuf.b = ws->f;
 	htc->rxbuf.e = ws->f;
 	*htc->rxbuf.e = '\0';
+	htc->rxscan = NULL;
+	htc->rxscanned = 0;
 	htc->pipeline.b = NULL;
 	htc->pipeline.e = NULL;
 }
@@ -84,6 +86,8 @@ HTTP1_Reinit(struct http_conn *htc)
 	(void)WS_Reserve(htc->ws, htc->maxbytes);
 	htc->rxbuf.b = htc->ws->f;
 	htc->rxbuf.e = htc->ws->f;
+	htc->rxscan = NULL;
+	htc->rxscanned = 0;
 	if (htc->pipeline.b != NULL) {
 		l = Tlen(htc->pipeline);
 		memmove(htc->rxbuf.b, htc->pipeline.b, l);
@@ -98,6 +102,9 @@ HTTP1_Reinit(struct http_conn *htc)
 /*--------------------------------------------------------------------
  * Check if we have a complete HTTP request or response yet
  *
+ * htc->rxscan remembers how far earlier calls got, so that a header
+ * arriving a few bytes at a time is not scanned over and over.
+ * htc->rxscanned adds up how many bytes were looked at.
  */
 
 enum htc_status_e
@@ -113,20 +120,34 @@ HTTP1_Complete(struct http_conn *htc)
 	Tcheck(*t);
 	assert(*t->e == '\0');
 
-	/* Skip any leading white space */
-	for (p = t->b ; vct_islws(*p); p++)
-		continue;
-	if (p == t->e) {
-		/* All white space */
-		t->e = t->b;
-		*t->e = '\0';
-		return (HTTP1_ALL_WHITESPACE);
+	p = htc->rxscan;
+	if (p == NULL) {
+		/* Skip any leading white space */
+		for (p = t->b ; vct_islws(*p); p++)
+			continue;
+		if (p == t->e) {
+			/* All white space */
+			t->e = t->b;
+			*t->e = '\0';
+			return (HTTP1_ALL_WHITESPACE);
+		}
+		htc->rxscan = p;
 	}
+	assert(p >= t->b && p <= t->e);
+	htc->rxscanned += t->e - p;
 	while (1) {
-		p = strchr(p, '\n');
-		if (p == NULL)
+		p = VCT_FindCRLF(p, t->e);
+		if (p == t->e) {
+			/*
+			 * No marker yet, but its first two bytes ([CR]NL)
+			 * may be the last ones we have.
+			 */
+			if (t->e - 2 > htc->rxscan)
+				htc->rxscan = t->e - 2;
 			return (HTTP1_NEED_MORE);
-		p++;
+		}
+		if (*p++ == '\r')
+			continue;
 		if (*p == '\r')
 			p++;
 		if (*p == '\n')
@@ -134,6 +155,7 @@ HTTP1_Complete(struct http_conn *htc)
 	}
 	p++;
 	i = p - t->b;
+	htc->rxscan = NULL;
 	WS_ReleaseP(htc->ws, htc->rxbuf.e);
 	AZ(htc->pipeline.b);
 	AZ(htc->pipeline.e);
@@ -187,27 +209,25 @@ HTTP1_Read(struct http_conn *htc, void *d, size_t len)
 	ssize_t i;
 
 	CHECK_OBJ_NOTNULL(htc, HTTP_CONN_MAGIC);
-	l = 0;
 	p = d;
 	if (htc->pipeline.b) {
 		l = Tlen(htc->pipeline);
 		if (l > len)
 			l = len;
 		memcpy(p, htc->pipeline.b, l);
-		p += l;
-		len -= l;
 		htc->pipeline.b += l;
 		if (htc->pipeline.b == htc->pipeline.e)
 			htc->pipeline.b = htc->pipeline.e = NULL;
-	}
-	if (len == 0)
+		/*
+		 * Do not block for more, a streaming delivery may be
+		 * waiting for what we already have.
+		 */
 		return (l);
-	i = read(htc->fd, p, len);
-	if (i < 0) {
-		VSLb(htc->vsl, SLT_FetchError, "%s", strerror(errno));
-		return (i);
 	}
-	return (i + l);
+	i = read(htc->fd, p, len);
+	if (i < 0)
+		VSLbs(htc->vsl, SLT_FetchError, strerror(errno));
+	return (i);
 }
 
 /*--------------------------------------------------------------------
@@ -232,10 +252,9 @@ htc_dissect_hdrs(struct http *hp, char *p, const struct http_conn *htc)
 		/* Find end of next header */
 		q = r = p;
 		while (r < t.e) {
-			if (!vct_iscrlf(*r)) {
-				r++;
-				continue;
-			}
+			r = TRUST_ME(VCT_FindCRLF(r, t.e));
+			if (r == t.e)
+				break;
 			q = r;
 			assert(r < t.e);
 			r += vct_skipcrlf(r);
@@ -273,6 +292,7 @@ htc_dissect_hdrs(struct http *hp, char *p, const struct http_conn *htc)
 			hp->hdf[hp->nhd] = 0;
 			hp->hd[hp->nhd].b = p;
 			hp->hd[hp->nhd].e = q;
+			hp->hdt[hp->nhd] = http_HdrTag(&hp->hd[hp->nhd]);
 			http_VSLH(hp, hp->nhd);
 			hp->nhd++;
 		} else {
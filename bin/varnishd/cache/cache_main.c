@@ -209,6 +209,7 @@ child_main(void)
 	WAIT_Init();
 	PAN_Init();
 	CLI_Init();
+	VSL_Init();
 	VFP_Init();
 
 	VCL_Init();
@@ -229,6 +230,7 @@ child_main(void)
 	VCA_Init();
 
 	SMS_Init();
+	SMF_Init();
 	SMP_Init();
 	STV_open();
 
@@ -26,6 +26,23 @@
  * SUCH DAMAGE.
  *
  * Generic memory pool
+ *
+ * In front of the pool, every thread has a small magazine per mempool
+ * holding items it freed, so a thread which gets and frees the same
+ * kind of item over and over (a worker handling requests) does so
+ * without taking the pool lock.  Magazines only ever take items from
+ * MPL_Free(), so the pool (and mpl_guard) still decides how many items
+ * exist.  Counters changed on the lock-free path are kept in the
+ * magazine and folded into the pool whenever the thread holds the
+ * pool lock anyway, every MPL_MAG_FOLD operations, when a worker goes
+ * idle (MPL_Fold()) and when the thread exits.
+ *
+ * Each pool has an index into the magazine array of the threads, which
+ * grows as more pools are made.  The index of a destroyed pool is given
+ * to the next new pool, and the generation number tells the magazines
+ * left over from the old pool apart.  Those hold on to the old pool,
+ * which waits for them in its guard thread, until their thread returns
+ * the items.
  */
 
 #include "config.h"
@@ -57,14 +74,49 @@ struct mempool {
 	struct lock			mtx;
 	volatile struct poolparam	*param;
 	volatile unsigned		*cur_size;
-	uint64_t			live;
+	int64_t				live;
 	struct VSC_C_mempool		*vsc;
 	unsigned			n_pool;
 	pthread_t			thread;
 	double				t_now;
 	int				self_destruct;
+
+	/* Items handed out or sitting in magazines */
+	uint64_t			n_out;
+	unsigned			idx;
+	unsigned			gen;
+};
+
+#define MPL_MAG_SIZE			2
+#define MPL_MAG_FOLD			64
+
+struct mpl_mag {
+	struct mempool			*mpl;
+	unsigned			gen;
+	unsigned			n;
+	struct memitem			*item[MPL_MAG_SIZE];
+
+	/* Not yet folded into the pool */
+	int				live;
+	unsigned			allocs;
+	unsigned			frees;
+	unsigned			hit;
 };
 
+struct mpl_rack {
+	unsigned			magic;
+#define MPL_RACK_MAGIC			0x6f3a9c15
+	unsigned			nmag;
+	struct mpl_mag			*mag;
+};
+
+static pthread_once_t		mpl_once = PTHREAD_ONCE_INIT;
+static pthread_key_t		mpl_key;
+static struct lock		mpl_mtx;
+static unsigned			mpl_nidx;
+static unsigned			mpl_gen;
+static struct mempool		**mpl_byidx;
+
 /*---------------------------------------------------------------------
  */
 
@@ -85,6 +137,188 @@ mpl_alloc(const struct mempool *mpl)
 	return (mi);
 }
 
+/*---------------------------------------------------------------------
+ * Fold the counters of a magazine into the pool.
+ */
+
+static void
+mpl_fold(struct mempool *mpl, struct mpl_mag *mag)
+{
+
+	Lck_AssertHeld(&mpl->mtx);
+	mpl->live += mag->live;
+	mpl->vsc->live = mpl->live < 0 ? 0 : mpl->live;
+	mpl->vsc->allocs += mag->allocs;
+	mpl->vsc->frees += mag->frees;
+	mpl->vsc->mag_hit += mag->hit;
+	mag->live = 0;
+	mag->allocs = mag->frees = mag->hit = 0;
+}
+
+/*---------------------------------------------------------------------
+ * Return an item to the pool, with the pool lock held.
+ */
+
+static void
+mpl_put(struct mempool *mpl, struct memitem *mi)
+{
+
+	Lck_AssertHeld(&mpl->mtx);
+	assert(mpl->n_out > 0);
+	mpl->n_out--;
+	if (mi->size < *mpl->cur_size) {
+		mpl->vsc->toosmall++;
+		VTAILQ_INSERT_HEAD(&mpl->surplus, mi, list);
+	} else {
+		mpl->vsc->pool = ++mpl->n_pool;
+		mi->touched = mpl->t_now;
+		VTAILQ_INSERT_HEAD(&mpl->list, mi, list);
+	}
+}
+
+/*---------------------------------------------------------------------
+ * Give up a magazine of a destroyed pool.  If it still has items, the
+ * pool waits for them and is around to take them back, otherwise it
+ * may be gone and we just forget the counters.
+ */
+
+static void
+mpl_mag_retire(struct mpl_mag *mag)
+{
+	struct mempool *mpl;
+
+	mpl = mag->mpl;
+	if (mag->n > 0) {
+		CHECK_OBJ_NOTNULL(mpl, MEMPOOL_MAGIC);
+		Lck_Lock(&mpl->mtx);
+		mpl_fold(mpl, mag);
+		while (mag->n > 0)
+			mpl_put(mpl, mag->item[--mag->n]);
+		Lck_Unlock(&mpl->mtx);
+	}
+	memset(mag, 0, sizeof *mag);
+}
+
+/*---------------------------------------------------------------------
+ * Fold the counters of all magazines of a thread into their pools, and
+ * optionally return the items too.  Magazines of destroyed pools are
+ * drained either way, so the pools can go away.
+ */
+
+static void
+mpl_rack_fold(struct mpl_rack *rack, int drain)
+{
+	struct mpl_mag *mag;
+	struct mempool *mpl;
+	unsigned u;
+	int locked = 0;
+
+	CHECK_OBJ_NOTNULL(rack, MPL_RACK_MAGIC);
+	for (u = 0; u < rack->nmag; u++) {
+		mag = &rack->mag[u];
+		if (mag->mpl == NULL)
+			continue;
+		if (mag->allocs + mag->frees == 0 && mag->n == 0)
+			continue;
+		/* With items in the magazine, mag->mpl is still around */
+		if (mag->allocs + mag->frees == 0 && !drain &&
+		    !mag->mpl->self_destruct)
+			continue;
+		if (!locked) {
+			Lck_Lock(&mpl_mtx);
+			locked = 1;
+		}
+		mpl = u < mpl_nidx ? mpl_byidx[u] : NULL;
+		if (mpl == NULL || mpl->gen != mag->gen) {
+			mpl_mag_retire(mag);
+			continue;
+		}
+		assert(mpl == mag->mpl);
+		Lck_Lock(&mpl->mtx);
+		mpl_fold(mpl, mag);
+		while (drain && mag->n > 0)
+			mpl_put(mpl, mag->item[--mag->n]);
+		Lck_Unlock(&mpl->mtx);
+	}
+	if (locked)
+		Lck_Unlock(&mpl_mtx);
+}
+
+static void
+mpl_rack_free(void *priv)
+{
+	struct mpl_rack *rack;
+
+	CAST_OBJ_NOTNULL(rack, priv, MPL_RACK_MAGIC);
+	mpl_rack_fold(rack, 1);
+	free(rack->mag);
+	FREE_OBJ(rack);
+}
+
+static void
+mpl_init(void)
+{
+
+	Lck_New(&mpl_mtx, lck_mempool);
+	AZ(pthread_key_create(&mpl_key, mpl_rack_free));
+}
+
+/*---------------------------------------------------------------------
+ * Find the magazine of this thread for a pool.
+ *
+ * A magazine of a newer generation means the pool has been destroyed
+ * and its index reused, items still coming back to it go to the pool.
+ */
+
+static struct mpl_mag *
+mpl_mag(struct mempool *mpl)
+{
+	struct mpl_rack *rack;
+	struct mpl_mag *mag;
+	unsigned n;
+
+	rack = pthread_getspecific(mpl_key);
+	if (rack == NULL) {
+		ALLOC_OBJ(rack, MPL_RACK_MAGIC);
+		if (rack == NULL)
+			return (NULL);
+		AZ(pthread_setspecific(mpl_key, rack));
+	}
+	CHECK_OBJ(rack, MPL_RACK_MAGIC);
+	if (mpl->idx >= rack->nmag) {
+		n = (mpl->idx | 7) + 1;
+		mag = realloc(rack->mag, n * sizeof *mag);
+		if (mag == NULL)
+			return (NULL);
+		memset(mag + rack->nmag, 0, (n - rack->nmag) * sizeof *mag);
+		rack->mag = mag;
+		rack->nmag = n;
+	}
+	mag = &rack->mag[mpl->idx];
+	if (mag->gen != mpl->gen) {
+		if (mag->gen > mpl->gen)
+			return (NULL);
+		if (mag->mpl != NULL)
+			mpl_mag_retire(mag);
+		mag->mpl = mpl;
+		mag->gen = mpl->gen;
+	}
+	assert(mag->mpl == mpl);
+	return (mag);
+}
+
+static void
+mpl_mag_fold(struct mempool *mpl, struct mpl_mag *mag)
+{
+
+	if (mag->allocs + mag->frees < MPL_MAG_FOLD)
+		return;
+	if (Lck_Trylock(&mpl->mtx))
+		return;
+	mpl_fold(mpl, mag);
+	Lck_Unlock(&mpl->mtx);
+}
+
 /*---------------------------------------------------------------------
  * Pool-guard
  *   Attempt to keep number of free items in pool inside bounds with
@@ -137,7 +371,6 @@ mpl_guard(void *priv)
 			continue;
 
 		if (mpl->self_destruct) {
-			AZ(mpl->live);
 			while (1) {
 				if (mi == NULL) {
 					mi = VTAILQ_FIRST(&mpl->list);
@@ -158,6 +391,11 @@ mpl_guard(void *priv)
 				FREE_OBJ(mi);
 				mi = NULL;
 			}
+			if (mpl->n_out > 0) {
+				/* Wait for the magazines to drain */
+				Lck_Unlock(&mpl->mtx);
+				continue;
+			}
 			VSM_Free(mpl->vsc);
 			Lck_Unlock(&mpl->mtx);
 			Lck_Delete(&mpl->mtx);
@@ -225,8 +463,10 @@ struct mempool *
 MPL_New(const char *name,
     volatile struct poolparam *pp, volatile unsigned *cur_size)
 {
-	struct mempool *mpl;
+	struct mempool *mpl, **byidx;
+	unsigned u, n;
 
+	AZ(pthread_once(&mpl_once, mpl_init));
 	ALLOC_OBJ(mpl, MEMPOOL_MAGIC);
 	AN(mpl);
 	bprintf(mpl->name, "%s", name);
@@ -239,6 +479,22 @@ MPL_New(const char *name,
 	mpl->vsc = VSM_Alloc(sizeof *mpl->vsc,
 	    VSC_CLASS, VSC_type_mempool, mpl->name);
 	AN(mpl->vsc);
+	Lck_Lock(&mpl_mtx);
+	for (u = 0; u < mpl_nidx; u++)
+		if (mpl_byidx[u] == NULL)
+			break;
+	if (u == mpl_nidx) {
+		n = mpl_nidx == 0 ? 16 : 2 * mpl_nidx;
+		byidx = realloc(mpl_byidx, n * sizeof *byidx);
+		AN(byidx);
+		memset(byidx + mpl_nidx, 0, (n - mpl_nidx) * sizeof *byidx);
+		mpl_byidx = byidx;
+		mpl_nidx = n;
+	}
+	mpl->idx = u;
+	mpl->gen = ++mpl_gen;
+	mpl_byidx[u] = mpl;
+	Lck_Unlock(&mpl_mtx);
 	AZ(pthread_create(&mpl->thread, NULL, mpl_guard, mpl));
 	AZ(pthread_detach(mpl->thread));
 	return (mpl);
@@ -246,7 +502,8 @@ MPL_New(const char *name,
 
 /*---------------------------------------------------------------------
  * Destroy a memory pool.  There must be no live items, and we cheat
- * and leave all the hard work to the guard thread.
+ * and leave all the hard work to the guard thread, which waits for
+ * any items still in thread magazines to come back.
  */
 
 void
@@ -258,10 +515,13 @@ MPL_Destroy(struct mempool **mpp)
 	mpl = *mpp;
 	*mpp = NULL;
 	CHECK_OBJ_NOTNULL(mpl, MEMPOOL_MAGIC);
+	Lck_Lock(&mpl_mtx);
+	assert(mpl_byidx[mpl->idx] == mpl);
+	mpl_byidx[mpl->idx] = NULL;
 	Lck_Lock(&mpl->mtx);
-	AZ(mpl->live);
 	mpl->self_destruct = 1;
 	Lck_Unlock(&mpl->mtx);
+	Lck_Unlock(&mpl_mtx);
 }
 
 /*---------------------------------------------------------------------
@@ -271,13 +531,37 @@ void *
 MPL_Get(struct mempool *mpl, unsigned *size)
 {
 	struct memitem *mi;
+	struct mpl_mag *mag;
 
 	CHECK_OBJ_NOTNULL(mpl, MEMPOOL_MAGIC);
 
+	mi = NULL;
+	mag = mpl_mag(mpl);
+	if (mag != NULL && mag->n > 0) {
+		mi = mag->item[--mag->n];
+		CHECK_OBJ_NOTNULL(mi, MEMITEM_MAGIC);
+		if (mi->size >= *mpl->cur_size) {
+			mag->allocs++;
+			mag->hit++;
+			mag->live++;
+			mpl_mag_fold(mpl, mag);
+			if (size != NULL)
+				*size = mi->size;
+			return ((void*)(uintptr_t)(mi+1));
+		}
+	}
+
 	Lck_Lock(&mpl->mtx);
 
+	if (mag != NULL)
+		mpl_fold(mpl, mag);
+	if (mi != NULL)
+		mpl_put(mpl, mi);	/* too small */
 	mpl->vsc->allocs++;
-	mpl->vsc->live = ++mpl->live;
+	mpl->vsc->mag_miss++;
+	mpl->live++;
+	mpl->vsc->live = mpl->live < 0 ? 0 : mpl->live;
+	mpl->n_out++;
 
 	do {
 		mi = VTAILQ_FIRST(&mpl->list);
@@ -313,6 +597,7 @@ void
 MPL_Free(struct mempool *mpl, void *item)
 {
 	struct memitem *mi;
+	struct mpl_mag *mag;
 
 	CHECK_OBJ_NOTNULL(mpl, MEMPOOL_MAGIC);
 	AN(item);
@@ -321,23 +606,45 @@ MPL_Free(struct mempool *mpl, void *item)
 	CHECK_OBJ_NOTNULL(mi, MEMITEM_MAGIC);
 	memset(item, 0, mi->size);
 
+	mag = mpl_mag(mpl);
+	if (mag != NULL && mag->n < MPL_MAG_SIZE &&
+	    mi->size >= *mpl->cur_size) {
+		mag->item[mag->n++] = mi;
+		mag->frees++;
+		mag->live--;
+		mpl_mag_fold(mpl, mag);
+		return;
+	}
+
 	Lck_Lock(&mpl->mtx);
 
+	if (mag != NULL)
+		mpl_fold(mpl, mag);
 	mpl->vsc->frees++;
-	mpl->vsc->live = --mpl->live;
-
-	if (mi->size < *mpl->cur_size) {
-		mpl->vsc->toosmall++;
-		VTAILQ_INSERT_HEAD(&mpl->surplus, mi, list);
-	} else {
-		mpl->vsc->pool = ++mpl->n_pool;
-		mi->touched = mpl->t_now;
-		VTAILQ_INSERT_HEAD(&mpl->list, mi, list);
-	}
+	mpl->live--;
+	mpl->vsc->live = mpl->live < 0 ? 0 : mpl->live;
+	mpl_put(mpl, mi);
 
 	Lck_Unlock(&mpl->mtx);
 }
 
+/*---------------------------------------------------------------------
+ * Called by worker threads when they go idle, so the counters do not
+ * lag behind for long.  Not between tasks, where mpl_mtx would be back
+ * on the path of every request.  The items stay in the magazines.
+ */
+
+void
+MPL_Fold(void)
+{
+	struct mpl_rack *rack;
+
+	AZ(pthread_once(&mpl_once, mpl_init));
+	rack = pthread_getspecific(mpl_key);
+	if (rack != NULL)
+		mpl_rack_fold(rack, 0);
+}
+
 void
 MPL_AssertSane(void *item)
 {
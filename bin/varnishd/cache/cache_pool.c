@@ -31,13 +31,46 @@
  * Pools can be added on the fly, as a means to mitigate lock contention,
  * but can only be removed again by a restart. (XXX: we could fix that)
  *
+ * Each pool has a small set of local task queues besides the shared
+ * queues.  When no idle thread is available, Pool_Task() parks FRONT
+ * tasks on one of the local queues, round-robin, holding only the
+ * mutex of that local queue.  Every worker has a home local queue, and
+ * when it finishes a task it looks there first and then steals from
+ * the other local queues of the pool, before it falls back to the
+ * shared queues under the pool mutex.  The shared front queue is the
+ * overflow path for when a local queue is full.
+ *
+ * A worker puts itself on the idle queue before it looks at the local
+ * queues a last time, and Pool_Task() looks for idle workers after it
+ * pushed to a local queue.  The local queue mutex orders the two, so
+ * either the worker finds the task, or Pool_Task() finds the worker
+ * and hands the task to it.
+ *
+ * With thread_pool_numa, pools are spread round-robin over the NUMA
+ * nodes, the herder and worker threads of a pool are bound to the CPUs
+ * of its node, and each pool accepts on its own SO_REUSEPORT copy of
+ * the listen sockets (see MGT_open_sockets()).
+ *
+ * With thread_queue_target, the herder of a pool wakes up every
+ * POOL_TICK to estimate the task arrival rate and the average wait of
+ * queued tasks, and creates enough threads in one go to drain the
+ * queue and absorb the arrivals during the excess wait.
+ *
  */
 
 #include "config.h"
 
 #include <math.h>
+#include <stdio.h>
 #include <stdlib.h>
 
+#ifdef HAVE_PTHREAD_SETAFFINITY_NP
+#  include <sched.h>
+#  ifdef HAVE_PTHREAD_NP_H
+#    include <pthread_np.h>
+#  endif
+#endif
+
 #include "cache.h"
 #include "common/heritage.h"
 
@@ -45,6 +78,33 @@
 
 VTAILQ_HEAD(taskhead, pool_task);
 
+#define POOL_NLQ			16
+#define POOL_LQ_LEN			16
+#define POOL_NHIST			6
+#define POOL_TICK			0.1
+
+static const double pool_hist_lim[POOL_NHIST - 1] = {
+	100e-6, 1e-3, 10e-3, 100e-3, 1.0
+};
+
+/* Arrival and queue wait statistics, protected by the lock of the queue */
+struct pool_qstat {
+	uint64_t			narrive;
+	uint64_t			nwait;
+	double				wait;
+	uint64_t			hist[POOL_NHIST];
+};
+
+/* Everything protected by the mtx */
+struct pool_lq {
+	struct lock			mtx;
+	unsigned			head;
+	unsigned			len;
+	struct pool_task		*task[POOL_LQ_LEN];
+	uintmax_t			nqueued;
+	struct pool_qstat		qs;
+};
+
 struct poolsock {
 	unsigned			magic;
 #define POOLSOCK_MAGIC			0x1b0a2d38
@@ -71,13 +131,102 @@ struct pool {
 	unsigned			lqueue;
 	uintmax_t			ndropped;
 	uintmax_t			nqueued;
+	uintmax_t			noverflow;
+	struct pool_qstat		qs;
+
+	struct pool_lq			lq[POOL_NLQ];
+	unsigned			lq_next;
+	unsigned			lq_nwrk;
+	int				node;
 	struct sesspool			*sesspool;
+
+	/* Adaptive herder estimates, owned by the herder */
+	double				t_tick;
+	uint64_t			tick_narrive;
+	uint64_t			tick_nwait;
+	double				tick_wait;
+	double				rate;
+	double				wait;
+	uint64_t			nspawned;
+
+	struct VSC_C_pool		*vsc;
 };
 
 static struct lock		pool_mtx;
 static pthread_t		thr_pool_herder;
 static unsigned			pool_accepting = 0;
 
+#ifdef HAVE_PTHREAD_SETAFFINITY_NP
+#define POOL_MAXNODE			64
+static unsigned			pool_nnode;
+static cpu_set_t		pool_nodecpus[POOL_MAXNODE];
+#endif
+
+/*--------------------------------------------------------------------
+ * NUMA topology, as the kernel reports it in sysfs.
+ */
+
+static void
+pool_numa_init(void)
+{
+#ifdef HAVE_PTHREAD_SETAFFINITY_NP
+	char fn[64], buf[1024], *p, *q;
+	unsigned long lo, hi;
+	cpu_set_t *cs;
+	FILE *f;
+
+	for (pool_nnode = 0; pool_nnode < POOL_MAXNODE; pool_nnode++) {
+		bprintf(fn, "/sys/devices/system/node/node%u/cpulist",
+		    pool_nnode);
+		/* sysfs files do not have a size, so no VFIL_readfile() */
+		f = fopen(fn, "r");
+		if (f == NULL)
+			break;
+		p = fgets(buf, sizeof buf, f);
+		AZ(fclose(f));
+		if (p == NULL)
+			break;
+		cs = &pool_nodecpus[pool_nnode];
+		CPU_ZERO(cs);
+		/* "0-3,8-11" */
+		for (p = buf; *p != '\0' && *p != '\n'; p = q) {
+			lo = hi = strtoul(p, &q, 10);
+			if (q == p)
+				break;
+			if (*q == '-')
+				hi = strtoul(q + 1, &q, 10);
+			for (; lo <= hi && lo < CPU_SETSIZE; lo++)
+				CPU_SET(lo, cs);
+			if (*q == ',')
+				q++;
+		}
+		if (CPU_COUNT(cs) == 0)
+			break;
+	}
+#endif
+}
+
+/*--------------------------------------------------------------------
+ * Bind the calling thread to the NUMA node of the pool.  This must
+ * happen before the thread touches its stack and workspace, so the
+ * kernel allocates them from node-local memory.
+ */
+
+void
+Pool_Bind(void *priv)
+{
+	struct pool *pp;
+
+	CAST_OBJ_NOTNULL(pp, priv, POOL_MAGIC);
+	if (pp->node < 0)
+		return;
+#ifdef HAVE_PTHREAD_SETAFFINITY_NP
+	assert(pp->node < (int)pool_nnode);
+	(void)pthread_setaffinity_np(pthread_self(),
+	    sizeof pool_nodecpus[pp->node], &pool_nodecpus[pp->node]);
+#endif
+}
+
 /*--------------------------------------------------------------------
  */
 
@@ -102,6 +251,161 @@ pool_getidleworker(struct pool *pp)
 	return (wrk);
 }
 
+/*--------------------------------------------------------------------
+ * Queue wait statistics
+ */
+
+static void
+pool_qwait(struct pool_qstat *qs, const struct pool_task *tp, double now)
+{
+	double w;
+	unsigned u;
+
+	w = now - tp->t_queued;
+	qs->nwait++;
+	qs->wait += w;
+	for (u = 0; u < POOL_NHIST - 1 && w >= pool_hist_lim[u]; u++)
+		continue;
+	qs->hist[u]++;
+}
+
+static void
+pool_qstat_sum(struct pool *pp, struct pool_qstat *qs)
+{
+	struct pool_lq *lq;
+	unsigned u, v;
+
+	Lck_AssertHeld(&pp->mtx);
+	*qs = pp->qs;
+	for (u = 0; u < POOL_NLQ; u++) {
+		lq = &pp->lq[u];
+		Lck_Lock(&lq->mtx);
+		qs->narrive += lq->qs.narrive;
+		qs->nwait += lq->qs.nwait;
+		qs->wait += lq->qs.wait;
+		for (v = 0; v < POOL_NHIST; v++)
+			qs->hist[v] += lq->qs.hist[v];
+		Lck_Unlock(&lq->mtx);
+	}
+}
+
+/*--------------------------------------------------------------------
+ * Local task queues
+ */
+
+static unsigned
+pool_lq_len(struct pool *pp)
+{
+	struct pool_lq *lq;
+	unsigned u, n;
+
+	n = 0;
+	for (u = 0; u < POOL_NLQ; u++) {
+		lq = &pp->lq[u];
+		Lck_Lock(&lq->mtx);
+		n += lq->len;
+		Lck_Unlock(&lq->mtx);
+	}
+	return (n);
+}
+
+static struct pool_task *
+pool_lq_pop(struct pool_lq *lq, double now)
+{
+	struct pool_task *tp;
+
+	Lck_AssertHeld(&lq->mtx);
+	if (lq->len == 0)
+		return (NULL);
+	tp = lq->task[lq->head];
+	lq->head = (lq->head + 1) % POOL_LQ_LEN;
+	lq->len--;
+	pool_qwait(&lq->qs, tp, now);
+	return (tp);
+}
+
+/*
+ * Park a FRONT task on a local queue without the pool mutex.  We leave
+ * it to the caller if there are idle workers to hand it to, if the
+ * overflow queue must drain first, or if the local queue has had its
+ * share of thread_queue_limit.  The unlocked looks at the pool are
+ * only hints, the pool mutex is taken afterwards if they say a worker
+ * went idle meanwhile, or if the herder has not been told we ran dry.
+ */
+
+static int
+pool_lq_push(struct pool *pp, struct pool_task *task)
+{
+	struct pool_lq *lq;
+	struct pool_task *tp;
+	struct worker *wrk;
+	unsigned lim;
+
+	if (!VTAILQ_EMPTY(&pp->idle_queue) || pp->lqueue > 0)
+		return (-1);
+	lim = cache_param->wthread_queue_limit / POOL_NLQ;
+	if (lim > POOL_LQ_LEN)
+		lim = POOL_LQ_LEN;
+
+	/* Lost updates of lq_next are of no concern */
+	lq = &pp->lq[pp->lq_next++ % POOL_NLQ];
+	Lck_Lock(&lq->mtx);
+	if (lq->len >= lim) {
+		Lck_Unlock(&lq->mtx);
+		return (-1);
+	}
+	task->t_queued = VTIM_mono();
+	lq->task[(lq->head + lq->len) % POOL_LQ_LEN] = task;
+	lq->len++;
+	lq->qs.narrive++;
+	lq->nqueued++;
+	Lck_Unlock(&lq->mtx);
+
+	if (VTAILQ_EMPTY(&pp->idle_queue) &&
+	    (pp->dry || pp->nthr >= cache_param->wthread_max))
+		return (0);
+
+	Lck_Lock(&pp->mtx);
+	wrk = pool_getidleworker(pp);
+	if (wrk != NULL) {
+		Lck_Lock(&lq->mtx);
+		tp = pool_lq_pop(lq, VTIM_mono());
+		Lck_Unlock(&lq->mtx);
+		if (tp != NULL) {
+			VTAILQ_REMOVE(&pp->idle_queue, &wrk->task, list);
+			AZ(wrk->task.func);
+			wrk->task.func = tp->func;
+			wrk->task.priv = tp->priv;
+			AZ(pthread_cond_signal(&wrk->cond));
+		}
+	}
+	Lck_Unlock(&pp->mtx);
+	return (0);
+}
+
+static struct pool_task *
+pool_lq_get(struct pool *pp, struct worker *wrk, unsigned home)
+{
+	struct pool_lq *lq;
+	struct pool_task *tp;
+	unsigned u;
+	double now;
+
+	now = VTIM_mono();
+	for (u = 0; u < POOL_NLQ; u++) {
+		lq = &pp->lq[(home + u) % POOL_NLQ];
+		Lck_Lock(&lq->mtx);
+		tp = pool_lq_pop(lq, now);
+		Lck_Unlock(&lq->mtx);
+		if (tp != NULL) {
+			if (u > 0)
+				wrk->stats.thread_queue_stolen++;
+			return (tp);
+		}
+	}
+	return (NULL);
+}
+
 /*--------------------------------------------------------------------
  * Nobody is accepting on this socket, so we do.
  *
@@ -163,6 +467,8 @@ pool_accept(struct worker *wrk, void *arg)
 		}
 		VTAILQ_REMOVE(&pp->idle_queue, &wrk2->task, list);
 		AZ(wrk2->task.func);
+		pp->qs.narrive++;
+		pp->qs.hist[0]++;
 		Lck_Unlock(&pp->mtx);
 		assert(sizeof *wa2 == WS_Reserve(wrk2->aws, sizeof *wa2));
 		wa2 = (void*)wrk2->aws->f;
@@ -194,7 +500,11 @@ Pool_Task(struct pool *pp, struct pool_task *task, enum pool_how how)
 	AN(task);
 	AN(task->func);
 
+	if (how == POOL_QUEUE_FRONT && !pool_lq_push(pp, task))
+		return (0);
+
 	Lck_Lock(&pp->mtx);
+	pp->qs.narrive++;
 
 	/*
 	 * The common case first:  Take an idle thread, do it.
@@ -202,6 +512,7 @@ Pool_Task(struct pool *pp, struct pool_task *task, enum pool_how how)
 
 	wrk = pool_getidleworker(pp);
 	if (wrk != NULL) {
+		pp->qs.hist[0]++;
 		VTAILQ_REMOVE(&pp->idle_queue, &wrk->task, list);
 		AZ(wrk->task.func);
 		Lck_Unlock(&pp->mtx);
@@ -217,14 +528,17 @@ Pool_Task(struct pool *pp, struct pool_task *task, enum pool_how how)
 		break;
 	case POOL_QUEUE_FRONT:
 		/* If we have too much in the queue already, refuse. */
-		if (pp->lqueue > cache_param->wthread_queue_limit) {
+		if (pp->lqueue + pool_lq_len(pp) >
+		    cache_param->wthread_queue_limit) {
 			pp->ndropped++;
 			retval = -1;
-		} else {
-			VTAILQ_INSERT_TAIL(&pp->front_queue, task, list);
-			pp->nqueued++;
-			pp->lqueue++;
+			break;
 		}
+		pp->nqueued++;
+		task->t_queued = VTIM_mono();
+		VTAILQ_INSERT_TAIL(&pp->front_queue, task, list);
+		pp->noverflow++;
+		pp->lqueue++;
 		break;
 	case POOL_QUEUE_BACK:
 		VTAILQ_INSERT_TAIL(&pp->back_queue, task, list);
@@ -246,35 +560,77 @@ Pool_Work_Thread(void *priv, struct worker *wrk)
 	struct pool *pp;
 	int stats_clean;
 	struct pool_task *tp;
+	unsigned home;
+	int folded;
 
 	CAST_OBJ_NOTNULL(pp, priv, POOL_MAGIC);
 	wrk->pool = pp;
 	stats_clean = 1;
+	folded = 1;
+	Lck_Lock(&pp->mtx);
+	home = pp->lq_nwrk++ % POOL_NLQ;
+	Lck_Unlock(&pp->mtx);
 	while (1) {
-		Lck_Lock(&pp->mtx);
-
 		CHECK_OBJ_NOTNULL(wrk, WORKER_MAGIC);
 
 		WS_Reset(wrk->aws, NULL);
 
+		tp = pool_lq_get(pp, wrk, home);
+		if (tp != NULL) {
+			assert(wrk->pool == pp);
+			tp->func(wrk, tp->priv);
+			stats_clean = WRK_TrySumStat(wrk);
+			folded = 0;
+			continue;
+		}
+
+		Lck_Lock(&pp->mtx);
+
 		tp = VTAILQ_FIRST(&pp->front_queue);
 		if (tp != NULL) {
 			pp->lqueue--;
 			VTAILQ_REMOVE(&pp->front_queue, tp, list);
+			pool_qwait(&pp->qs, tp, VTIM_mono());
 		} else {
+			/*
+			 * Only accept tasks go on the back queue, from the
+			 * moment the pool is created and again whenever an
+			 * acceptor had to take a session itself.  How long
+			 * they sit there is not the queue wait of requests,
+			 * so the herder must not see it.
+			 */
 			tp = VTAILQ_FIRST(&pp->back_queue);
 			if (tp != NULL)
 				VTAILQ_REMOVE(&pp->back_queue, tp, list);
 		}
 
+		if (tp == NULL && !folded) {
+			/*
+			 * Going idle, fold what this thread kept to itself
+			 * and look again, the global locks are only taken
+			 * here and not for every task.
+			 */
+			Lck_Unlock(&pp->mtx);
+			MPL_Fold();
+			VSL_Fold();
+			folded = 1;
+			continue;
+		}
+
 		if (tp == NULL) {
-			/* Nothing to do: To sleep, perchance to dream ... */
-			if (isnan(wrk->lastused))
-				wrk->lastused = VTIM_real();
 			wrk->task.func = NULL;
 			wrk->task.priv = wrk;
-			AZ(wrk->task.func);
 			VTAILQ_INSERT_HEAD(&pp->idle_queue, &wrk->task, list);
+			if (pool_lq_len(pp) > 0) {
+				/* Somebody parked a task locally, go steal it */
+				VTAILQ_REMOVE(&pp->idle_queue, &wrk->task, list);
+				Lck_Unlock(&pp->mtx);
+				continue;
+			}
+
+			/* Nothing to do: To sleep, perchance to dream ... */
+			if (isnan(wrk->lastused))
+				wrk->lastused = VTIM_real();
 			if (!stats_clean)
 				WRK_SumStat(wrk);
 			(void)Lck_CondWait(&wrk->cond, &pp->mtx, NULL);
@@ -288,6 +644,7 @@ Pool_Work_Thread(void *priv, struct worker *wrk)
 		assert(wrk->pool == pp);
 		tp->func(wrk, tp->priv);
 		stats_clean = WRK_TrySumStat(wrk);
+		folded = 0;
 	}
 	wrk->pool = NULL;
 }
@@ -297,18 +654,20 @@ Pool_Work_Thread(void *priv, struct worker *wrk)
  */
 
 static void
-pool_breed(struct pool *qp, const pthread_attr_t *tp_attr)
+pool_breed(struct pool *qp, const pthread_attr_t *tp_attr, unsigned n)
 {
 	pthread_t tp;
 
-	if (pthread_create(&tp, tp_attr, WRK_thread, qp)) {
-		VSL(SLT_Debug, 0, "Create worker thread failed %d %s",
-		    errno, strerror(errno));
-		Lck_Lock(&pool_mtx);
-		VSC_C_main->threads_failed++;
-		Lck_Unlock(&pool_mtx);
-		VTIM_sleep(cache_param->wthread_fail_delay);
-	} else {
+	for (; n > 0; n--) {
+		if (pthread_create(&tp, tp_attr, WRK_thread, qp)) {
+			VSL(SLT_Debug, 0, "Create worker thread failed %d %s",
+			    errno, strerror(errno));
+			Lck_Lock(&pool_mtx);
+			VSC_C_main->threads_failed++;
+			Lck_Unlock(&pool_mtx);
+			VTIM_sleep(cache_param->wthread_fail_delay);
+			return;
+		}
 		AZ(pthread_detach(tp));
 		qp->dry = 0;
 		qp->nthr++;
@@ -316,8 +675,65 @@ pool_breed(struct pool *qp, const pthread_attr_t *tp_attr)
 		VSC_C_main->threads++;
 		VSC_C_main->threads_created++;
 		Lck_Unlock(&pool_mtx);
-		VTIM_sleep(cache_param->wthread_add_delay);
 	}
+	VTIM_sleep(cache_param->wthread_add_delay);
+}
+
+/*--------------------------------------------------------------------
+ * How many threads should we create ?
+ *
+ * The classic herder creates one whenever the pool ran dry.
+ *
+ * The adaptive herder, once per POOL_TICK, estimates the arrival rate
+ * and the average wait of the tasks dequeued since the last tick.  If
+ * the wait is above thread_queue_target, it asks for enough threads to
+ * drain the queue and to take the tasks which will arrive during the
+ * excess wait.  Otherwise it behaves like the classic herder, but
+ * only once per tick.
+ */
+
+static unsigned
+pool_want(struct pool *pp)
+{
+	struct pool_qstat qs;
+	double now, dt, target;
+	unsigned n, q;
+
+	n = pp->dry ? 1 : 0;
+	target = cache_param->wthread_queue_target;
+	if (target == 0.)
+		return (n);
+	now = VTIM_mono();
+	dt = now - pp->t_tick;
+	if (dt < POOL_TICK)
+		return (0);
+
+	Lck_Lock(&pp->mtx);
+	pool_qstat_sum(pp, &qs);
+	q = pp->lqueue + pool_lq_len(pp);
+	pp->rate = .75 * pp->rate + .25 * (qs.narrive - pp->tick_narrive) / dt;
+	if (qs.nwait > pp->tick_nwait)
+		pp->wait = (qs.wait - pp->tick_wait) /
+		    (qs.nwait - pp->tick_nwait);
+	else if (q > 0)
+		pp->wait = dt;		/* Nothing got a thread */
+	else
+		pp->wait = 0.;
+	pp->tick_narrive = qs.narrive;
+	pp->tick_nwait = qs.nwait;
+	pp->tick_wait = qs.wait;
+	pp->t_tick = now;
+	Lck_Unlock(&pp->mtx);
+
+	if (pp->wait <= target)
+		return (n);
+	n = q + (unsigned)ceil(pp->rate * (pp->wait - target));
+	if (n == 0)
+		n = 1;
+	if (n > cache_param->wthread_max - pp->nthr)
+		n = cache_param->wthread_max - pp->nthr;
+	pp->nspawned += n;
+	return (n);
 }
 
 /*--------------------------------------------------------------------
@@ -344,7 +760,12 @@ pool_herder(void *priv)
 	double t_idle;
 	struct worker *wrk;
 
+	struct pool_lq *lq;
+	struct timespec ts;
+	unsigned n, u;
+
 	CAST_OBJ_NOTNULL(pp, priv, POOL_MAGIC);
+	Pool_Bind(pp);
 	AZ(pthread_attr_init(&tp_attr));
 
 	while (1) {
@@ -358,11 +779,17 @@ pool_herder(void *priv)
 		}
 
 		/* Make more threads if needed and allowed */
-		if (pp->nthr < cache_param->wthread_min ||
-		    (pp->dry && pp->nthr < cache_param->wthread_max)) {
-			pool_breed(pp, &tp_attr);
+		if (pp->nthr < cache_param->wthread_min) {
+			pool_breed(pp, &tp_attr, 1);
 			continue;
 		}
+		if (pp->nthr < cache_param->wthread_max) {
+			n = pool_want(pp);
+			if (n > 0) {
+				pool_breed(pp, &tp_attr, n);
+				continue;
+			}
+		}
 
 		if (pp->nthr > cache_param->wthread_min) {
 
@@ -372,7 +799,15 @@ pool_herder(void *priv)
 			/* XXX: unsafe counters */
 			VSC_C_main->sess_queued += pp->nqueued;
 			VSC_C_main->sess_dropped += pp->ndropped;
-			pp->nqueued = pp->ndropped = 0;
+			VSC_C_main->thread_queue_overflow += pp->noverflow;
+			pp->nqueued = pp->ndropped = pp->noverflow = 0;
+			for (u = 0; u < POOL_NLQ; u++) {
+				lq = &pp->lq[u];
+				Lck_Lock(&lq->mtx);
+				VSC_C_main->sess_queued += lq->nqueued;
+				lq->nqueued = 0;
+				Lck_Unlock(&lq->mtx);
+			}
 
 			wrk = NULL;
 			pt = VTAILQ_LAST(&pp->idle_queue, taskhead);
@@ -404,7 +839,10 @@ pool_herder(void *priv)
 		}
 
 		Lck_Lock(&pp->mtx);
-		if (!pp->dry)
+		if (cache_param->wthread_queue_target > 0.) {
+			ts = VTIM_timespec(VTIM_real() + POOL_TICK);
+			(void)Lck_CondWait(&pp->herder_cond, &pp->mtx, &ts);
+		} else if (!pp->dry)
 			(void)Lck_CondWait(&pp->herder_cond, &pp->mtx, NULL);
 		Lck_Unlock(&pp->mtx);
 	}
@@ -421,11 +859,28 @@ pool_mkpool(unsigned pool_no)
 	struct pool *pp;
 	struct listen_sock *ls;
 	struct poolsock *ps;
+	unsigned u;
+	char nb[8];
 
 	ALLOC_OBJ(pp, POOL_MAGIC);
 	if (pp == NULL)
 		return (NULL);
+	bprintf(nb, "%u", pool_no);
+	pp->vsc = VSM_Alloc(sizeof *pp->vsc, VSC_CLASS, VSC_type_pool, nb);
+	AN(pp->vsc);
+	pp->t_tick = VTIM_mono();
 	Lck_New(&pp->mtx, lck_wq);
+	for (u = 0; u < POOL_NLQ; u++)
+		Lck_New(&pp->lq[u].mtx, lck_wq);
+
+	pp->node = -1;
+#ifdef HAVE_PTHREAD_SETAFFINITY_NP
+	if (cache_param->wthread_numa && pool_nnode > 0) {
+		pp->node = pool_no % pool_nnode;
+		pp->vsc->node = pp->node;
+		pp->vsc->cpus = CPU_COUNT(&pool_nodecpus[pp->node]);
+	}
+#endif
 
 	VTAILQ_INIT(&pp->idle_queue);
 	VTAILQ_INIT(&pp->front_queue);
@@ -438,6 +893,9 @@ pool_mkpool(unsigned pool_no)
 	VTAILQ_FOREACH(ls, &heritage.socks, list) {
 		if (ls->sock < 0)
 			continue;
+		if (heritage.sock_pools > 1 &&
+		    ls->pool != pool_no % heritage.sock_pools)
+			continue;
 		ALLOC_OBJ(ps, POOLSOCK_MAGIC);
 		XXXAN(ps);
 		ps->lsock = ls;
@@ -449,6 +907,34 @@ pool_mkpool(unsigned pool_no)
 	return (pp);
 }
 
+/*--------------------------------------------------------------------
+ * Update the counters of a pool
+ */
+
+static void
+pool_stats(struct pool *pp)
+{
+	struct VSC_C_pool *vsc;
+	struct pool_qstat qs;
+
+	vsc = pp->vsc;
+	Lck_Lock(&pp->mtx);
+	pool_qstat_sum(pp, &qs);
+	vsc->queue_len = pp->lqueue + pool_lq_len(pp);
+	vsc->arrivals = qs.narrive;
+	Lck_Unlock(&pp->mtx);
+	vsc->threads = pp->nthr;
+	vsc->spawned = pp->nspawned;
+	vsc->rate = (uint64_t)pp->rate;
+	vsc->wait_avg = (uint64_t)(pp->wait * 1e6);
+	vsc->wait_100us = qs.hist[0];
+	vsc->wait_1ms = qs.hist[1];
+	vsc->wait_10ms = qs.hist[2];
+	vsc->wait_100ms = qs.hist[3];
+	vsc->wait_1s = qs.hist[4];
+	vsc->wait_more = qs.hist[5];
+}
+
 /*--------------------------------------------------------------------
  * This thread adjusts the number of pools to match the parameter.
  *
@@ -481,8 +967,10 @@ pool_poolherder(void *priv)
 			SES_DeletePool(NULL);
 		(void)sleep(1);
 		u = 0;
-		VTAILQ_FOREACH(pp, &pools, list)
-			u += pp->lqueue;
+		VTAILQ_FOREACH(pp, &pools, list) {
+			u += pp->lqueue + pool_lq_len(pp);
+			pool_stats(pp);
+		}
 		VSC_C_main->thread_queue_len = u;
 	}
 	NEEDLESS_RETURN(NULL);
@@ -503,5 +991,6 @@ Pool_Init(void)
 {
 
 	Lck_New(&pool_mtx, lck_wq);
+	pool_numa_init();
 	AZ(pthread_create(&thr_pool_herder, NULL, pool_poolherder, NULL));
 }
@@ -75,6 +75,25 @@ DOT acceptor -> recv [style=bold,color=green]
 #include "compat/srandomdev.h"
 #endif
 
+/*--------------------------------------------------------------------
+ * Drop the object of a request.  While the object is being fetched the
+ * request also holds on to the busyobj, which owns pass objects.
+ */
+
+static void
+cnt_drop_obj(struct worker *wrk, struct req *req)
+{
+
+	CHECK_OBJ_NOTNULL(req->obj, OBJECT_MAGIC);
+	CHECK_OBJ_ORNULL(req->busyobj, BUSYOBJ_MAGIC);
+	if (req->busyobj != NULL && req->obj->objcore->objhead == NULL)
+		req->obj = NULL;
+	else
+		(void)HSH_Deref(&wrk->stats, NULL, &req->obj);
+	if (req->busyobj != NULL)
+		VBO_DerefBusyObj(wrk, &req->busyobj);
+}
+
 /*--------------------------------------------------------------------
  * We have a refcounted object on the session, and possibly the busyobj
  * which is fetching it, prepare a response.
@@ -106,7 +125,7 @@ cnt_prepresp(struct worker *wrk, struct req *req)
 
 	req->res_mode = 0;
 
-	if (bo == NULL) {
+	if (bo == NULL || bo->state == BOS_FINISHED) {
 		if (!req->disable_esi && req->obj->esidata != NULL) {
 			/* In ESI mode, we can't know the aggregate length */
 			req->res_mode &= ~RES_LEN;
@@ -156,7 +175,13 @@ cnt_prepresp(struct worker *wrk, struct req *req)
 			req->obj->last_use = req->t_resp; /* XXX: locking ? */
 	}
 	HTTP_Setup(req->resp, req->ws, req->vsl, HTTP_Resp);
-	RES_BuildHttp(req);
+	if (bo != NULL) {
+		/* The fetch edits the headers when it is done */
+		Lck_Lock(&bo->mtx);
+		RES_BuildHttp(req);
+		Lck_Unlock(&bo->mtx);
+	} else
+		RES_BuildHttp(req);
 
 	VCL_deliver_method(req->vcl, wrk, req, NULL, req->http->ws);
 	switch (wrk->handling) {
@@ -165,15 +190,9 @@ cnt_prepresp(struct worker *wrk, struct req *req)
 	case VCL_RET_RESTART:
 		if (req->restarts >= cache_param->max_restarts)
 			break;
-		if (bo != NULL) {
-			AN(bo->do_stream);
-			assert(req->obj == bo->fetch_obj);
-			req->obj = NULL;
-			VBO_DerefBusyObj(wrk, &req->busyobj);
-		} else {
-			(void)HSH_Deref(&wrk->stats, NULL, &req->obj);
-		}
+		cnt_drop_obj(wrk, req);
 		AZ(req->obj);
+		AZ(req->busyobj);
 		http_Teardown(req->resp);
 		req->req_step = R_STP_RESTART;
 		return (REQ_FSM_MORE);
@@ -211,32 +230,33 @@ cnt_deliver(struct worker *wrk, struct req *req)
 	CHECK_OBJ_ORNULL(bo, BUSYOBJ_MAGIC);
 
 	if (bo != NULL) {
-		while (bo->state < BOS_FAILED)
-			(void)usleep(10000);
-		assert(bo->state >= BOS_FAILED);
-
+		/* Only plain bodies can be sent while they are fetched */
+		if (req->res_mode & (RES_LEN|RES_ESI|RES_ESI_CHILD|RES_GUNZIP))
+			VBO_waitstate(bo, BOS_FAILED);
 		if (bo->state == BOS_FAILED) {
-			(void)HSH_Deref(&wrk->stats, NULL, &req->obj);
-			VBO_DerefBusyObj(wrk, &req->busyobj);
+			cnt_drop_obj(wrk, req);
 			req->err_code = 503;
 			req->req_step = R_STP_ERROR;
 			return (REQ_FSM_MORE);
 		}
-		VBO_DerefBusyObj(wrk, &req->busyobj);
 	}
 
-	AZ(req->busyobj);
 	req->director = NULL;
 	req->restarts = 0;
 
 	RES_WriteObj(req);
 
 	/* No point in saving the body if it is hit-for-pass */
-	if (req->obj->objcore->flags & OC_F_PASS)
-		STV_Freestore(req->obj);
+	if (req->obj->objcore->flags & OC_F_PASS) {
+		/* ...once the fetch is done with it */
+		if (bo != NULL)
+			VBO_waitstate(bo, BOS_FAILED);
+		if (bo == NULL || bo->state == BOS_FINISHED)
+			STV_Freestore(req->obj);
+	}
 
 	assert(WRW_IsReleased(wrk));
-	(void)HSH_Deref(&wrk->stats, NULL, &req->obj);
+	cnt_drop_obj(wrk, req);
 	http_Teardown(req->resp);
 	return (REQ_FSM_DONE);
 }
@@ -351,27 +371,36 @@ DOT fetch -> prepresp [style=bold,color=blue]
 static enum req_fsm_nxt
 cnt_fetch(struct worker *wrk, struct req *req)
 {
+	struct busyobj *bo;
+	struct object *o;
 
 	CHECK_OBJ_NOTNULL(wrk, WORKER_MAGIC);
 	CHECK_OBJ_NOTNULL(req, REQ_MAGIC);
 
 	req->acct_req.fetch++;
-	AN(req->busyobj);
-	assert(req->busyobj->refcount > 0);
+	bo = req->busyobj;
+	CHECK_OBJ_NOTNULL(bo, BUSYOBJ_MAGIC);
+	assert(bo->refcount > 0);
 	(void)HTTP1_DiscardReqBody(req);
-	while (req->busyobj->state < BOS_FAILED) {
-		printf("YYY\n");
-		(void)usleep(100000);
-	}
-	if (req->busyobj->state == BOS_FAILED) {
+
+	/* do_stream and do_esi are settled once the body fetch starts */
+	VBO_waitstate(bo, BOS_FETCHING);
+	if (!cache_param->rush_stream || !bo->do_stream || bo->do_esi)
+		VBO_waitstate(bo, BOS_FAILED);
+
+	if (bo->state == BOS_FAILED) {
+		/* Drop the reference the fetch gave us, if it got that far */
+		o = bo->fetch_obj;
+		if (o != NULL && o->objcore->objhead != NULL)
+			(void)HSH_Deref(&wrk->stats, NULL, &o);
 		VBO_DerefBusyObj(wrk, &req->busyobj);
 		req->err_code = 503;
 		req->req_step = R_STP_ERROR;
 	} else {
-		assert (req->busyobj->state == BOS_FINISHED);
-		req->err_code = req->busyobj->err_code;
-		req->obj = req->busyobj->fetch_obj;
-		VBO_DerefBusyObj(wrk, &req->busyobj);
+		/* We keep the busyobj until the object is delivered */
+		req->err_code = bo->err_code;
+		req->obj = bo->fetch_obj;
+		CHECK_OBJ_NOTNULL(req->obj, OBJECT_MAGIC);
 		assert(WRW_IsReleased(wrk));
 		req->req_step = R_STP_PREPRESP;
 	}
@@ -419,7 +448,9 @@ cnt_lookup(struct worker *wrk, struct req *req)
 	AZ(req->objcore);
 
 	CHECK_OBJ_NOTNULL(req->vcl, VCL_CONF_MAGIC);
-	AZ(req->busyobj);
+	/* A request handed a streaming object comes with its busyobj */
+	if (req->hash_objcore == NULL)
+		AZ(req->busyobj);
 
 	VRY_Prep(req);
 
@@ -460,12 +491,12 @@ cnt_lookup(struct worker *wrk, struct req *req)
 	CHECK_OBJ_NOTNULL(oc, OBJCORE_MAGIC);
 	AZ (oc->flags & OC_F_BUSY);
 	AZ(req->objcore);
-	AZ(req->busyobj);
 
 	if (oc->flags & OC_F_PASS) {
 		/* Found a hit-for-pass */
 		VSLb(req->vsl, SLT_Debug, "XXXX HIT-FOR-PASS\n");
 		AZ(boc);
+		AZ(req->busyobj);
 		(void)HSH_Deref(&wrk->stats, oc, NULL);
 		req->objcore = NULL;
 		wrk->stats.cache_hitpass++;
@@ -475,15 +506,17 @@ cnt_lookup(struct worker *wrk, struct req *req)
 
 	oh = oc->objhead;
 	CHECK_OBJ_NOTNULL(oh, OBJHEAD_MAGIC);
+	EXP_Hit(oc);
 
-	/* We are not prepared to do streaming yet */
-	XXXAZ(req->busyobj);
+	/* Only a hit on an object which is still being fetched streams */
+	if (req->busyobj != NULL)
+		AZ(boc);
 
 	o = oc_getobj(&wrk->stats, oc);
 	CHECK_OBJ_NOTNULL(o, OBJECT_MAGIC);
 	req->obj = o;
 
-	VSLb(req->vsl, SLT_Hit, "%u", req->obj->vxid);
+	VSLbu(req->vsl, SLT_Hit, NULL, req->obj->vxid);
 
 	VCL_lookup_method(req->vcl, wrk, req, NULL, req->http->ws);
 
@@ -499,7 +532,7 @@ cnt_lookup(struct worker *wrk, struct req *req)
 		req->req_step = R_STP_PREPRESP;
 		return (REQ_FSM_MORE);
 	case VCL_RET_FETCH:
-		(void)HSH_Deref(&wrk->stats, NULL, &req->obj);
+		cnt_drop_obj(wrk, req);
 		req->objcore = boc;
 		req->req_step = R_STP_MISS;
 		return (REQ_FSM_MORE);
@@ -518,7 +551,7 @@ cnt_lookup(struct worker *wrk, struct req *req)
 	}
 
 	/* Drop our object, we won't need it */
-	(void)HSH_Deref(&wrk->stats, NULL, &req->obj);
+	cnt_drop_obj(wrk, req);
 	req->objcore = NULL;
 
 	if (boc != NULL) {
@@ -886,6 +919,7 @@ CNT_Request(struct worker *wrk, struct req *req)
 {
 	enum req_fsm_nxt nxt;
 	struct storage *st;
+	double t[5];
 
 	CHECK_OBJ_NOTNULL(wrk, WORKER_MAGIC);
 	CHECK_OBJ_NOTNULL(req, REQ_MAGIC);
@@ -936,15 +970,15 @@ CNT_Request(struct worker *wrk, struct req *req)
 	if (nxt == REQ_FSM_DONE) {
 		/* XXX: Workaround for pipe */
 		if (req->sp->fd >= 0) {
-			VSLb(req->vsl, SLT_Length, "%ju",
+			VSLbu(req->vsl, SLT_Length, NULL,
 			    (uintmax_t)req->resp_bodybytes);
 		}
-		VSLb(req->vsl, SLT_ReqEnd, "%.9f %.9f %.9f %.9f %.9f",
-		    req->t_req,
-		    req->sp->t_idle,
-		    req->sp->t_idle - req->t_resp,
-		    req->t_resp - req->t_req,
-		    req->sp->t_idle - req->t_resp);
+		t[0] = req->t_req;
+		t[1] = req->sp->t_idle;
+		t[2] = req->sp->t_idle - req->t_resp;
+		t[3] = req->t_resp - req->t_req;
+		t[4] = req->sp->t_idle - req->t_resp;
+		VSLbts(req->vsl, SLT_ReqEnd, t, 5);
 
 		while (!VTAILQ_EMPTY(&req->body)) {
 			st = VTAILQ_FIRST(&req->body);
@@ -959,7 +993,7 @@ CNT_Request(struct worker *wrk, struct req *req)
 		 * Nuke the VXID, cache_http1_fsm.c::http1_dissect() will
 		 * allocate a new one when necessary.
 		 */
-		VSLb(req->vsl, SLT_End, "%s", "");
+		VSLbs(req->vsl, SLT_End, "");
 		req->vsl->wid = 0;
 	}
 
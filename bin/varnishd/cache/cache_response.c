@@ -152,6 +152,35 @@ RES_BuildHttp(struct req *req)
 	    req->doclose ? "close" : "keep-alive");
 }
 
+/*--------------------------------------------------------------------
+ * Keep the stevedore reading delivery_prefetch bytes ahead of what we
+ * write.  *pst and *pend track the last segment we prefetched and where
+ * it ends in the body, segments which end before pos are skipped.
+ */
+
+static void
+res_Prefetch(const struct req *req, struct storage **pst, ssize_t *pend,
+    ssize_t pos)
+{
+	struct storage *st;
+
+	if (cache_param->delivery_prefetch == 0)
+		return;
+	st = *pst;
+	while (*pend < req->obj->len &&
+	    *pend < pos + cache_param->delivery_prefetch) {
+		if (st == NULL)
+			st = VTAILQ_FIRST(&req->obj->store);
+		else
+			st = VTAILQ_NEXT(st, list);
+		CHECK_OBJ_NOTNULL(st, STORAGE_MAGIC);
+		*pend += st->len;
+		if (*pend > pos)
+			STV_Prefetch(st);
+	}
+	*pst = st;
+}
+
 /*--------------------------------------------------------------------
  * We have a gzip'ed object and need to ungzip it for a client which
  * does not understand gzip.
@@ -161,7 +190,8 @@ RES_BuildHttp(struct req *req)
 static void
 res_WriteGunzipObj(struct req *req)
 {
-	struct storage *st;
+	struct storage *st, *pf = NULL;
+	ssize_t pfend = 0;
 	unsigned u = 0;
 	struct vgz *vg;
 	int i;
@@ -174,6 +204,7 @@ res_WriteGunzipObj(struct req *req)
 	VTAILQ_FOREACH(st, &req->obj->store, list) {
 		CHECK_OBJ_NOTNULL(req, REQ_MAGIC);
 		CHECK_OBJ_NOTNULL(st, STORAGE_MAGIC);
+		res_Prefetch(req, &pf, &pfend, u);
 		u += st->len;
 
 		i = VGZ_WrwGunzip(req, vg, st->ptr, st->len);
@@ -190,9 +221,9 @@ res_WriteGunzipObj(struct req *req)
 static void
 res_WriteDirObj(struct req *req, ssize_t low, ssize_t high)
 {
-	ssize_t u = 0;
+	ssize_t u = 0, pfend = 0;
 	size_t ptr, off, len;
-	struct storage *st;
+	struct storage *st, *pf = NULL;
 
 	CHECK_OBJ_NOTNULL(req, REQ_MAGIC);
 
@@ -218,6 +249,7 @@ res_WriteDirObj(struct req *req, ssize_t low, ssize_t high)
 			/* Chop tail of segment off */
 			len = 1 + high - ptr;
 
+		res_Prefetch(req, &pf, &pfend, ptr);
 		ptr += len;
 
 		req->acct_req.bodybytes += len;
@@ -226,6 +258,56 @@ res_WriteDirObj(struct req *req, ssize_t low, ssize_t high)
 	assert(u == req->obj->len);
 }
 
+/*--------------------------------------------------------------------
+ * Deliver an object while its body is being fetched.  We send what the
+ * fetch has published with VBO_extend() and sleep for more.  Only the
+ * last storage segment grows, and it is not trimmed while we may be
+ * looking at it.
+ * Returns -1 if the fetch failed.
+ */
+
+static int
+res_WriteStreamObj(struct req *req)
+{
+	struct busyobj *bo;
+	struct storage *st;
+	ssize_t l, sent, off, len;
+
+	CHECK_OBJ_NOTNULL(req, REQ_MAGIC);
+	bo = req->busyobj;
+	CHECK_OBJ_NOTNULL(bo, BUSYOBJ_MAGIC);
+
+	st = NULL;
+	off = 0;
+	sent = 0;
+	while (1) {
+		l = VBO_waitlen(bo, sent);
+		if (l < 0)
+			return (-1);
+		if (l == sent)
+			return (0);
+		while (sent < l) {
+			if (st == NULL) {
+				st = VTAILQ_FIRST(&req->obj->store);
+			} else if (off == st->len) {
+				st = VTAILQ_NEXT(st, list);
+				off = 0;
+			}
+			CHECK_OBJ_NOTNULL(st, STORAGE_MAGIC);
+			len = st->len - off;
+			if (len > l - sent)
+				len = l - sent;
+			req->acct_req.bodybytes += len;
+			(void)WRW_Write(req->wrk, st->ptr + off, len);
+			off += len;
+			sent += len;
+		}
+		if (WRW_Flush(req->wrk))
+			/* The client is gone */
+			return (0);
+	}
+}
+
 /*--------------------------------------------------------------------
  * Deliver an object.
  * Attempt optimizations like 304 and 206 here.
@@ -236,6 +318,7 @@ RES_WriteObj(struct req *req)
 {
 	char *r;
 	ssize_t low, high;
+	int fail = 0;
 
 	CHECK_OBJ_NOTNULL(req, REQ_MAGIC);
 
@@ -270,6 +353,10 @@ RES_WriteObj(struct req *req)
 
 	if (!req->wantbody) {
 		/* This was a HEAD or conditional request */
+	} else if (req->busyobj != NULL && !(req->res_mode &
+	    (RES_LEN|RES_ESI|RES_ESI_CHILD|RES_GUNZIP))) {
+		/* Possibly still being fetched, see cnt_deliver() */
+		fail = res_WriteStreamObj(req);
 	} else if (req->obj->len == 0) {
 		/* Nothing to do here */
 	} else if (req->res_mode & RES_ESI) {
@@ -285,7 +372,10 @@ RES_WriteObj(struct req *req)
 		res_WriteDirObj(req, low, high);
 	}
 
-	if (req->res_mode & RES_CHUNKED &&
+	if (fail) {
+		/* Don't let the client mistake what we sent for the body */
+		req->doclose = SC_TX_ERROR;
+	} else if (req->res_mode & RES_CHUNKED &&
 	    !(req->res_mode & RES_ESI_CHILD))
 		WRW_EndChunk(req->wrk);
 
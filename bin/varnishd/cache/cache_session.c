@@ -239,11 +239,13 @@ SES_pool_accept_task(struct worker *wrk, void *arg)
 /*--------------------------------------------------------------------
  * Schedule a request back on a work-thread from its sessions pool
  *
- * This is used to reschedule requests waiting on busy objects
+ * This is used to reschedule requests waiting on busy objects.
+ * With POOL_NO_QUEUE a failure leaves the request to the caller,
+ * otherwise the session is dropped.
  */
 
 int
-SES_ScheduleReq(struct req *req)
+SES_ScheduleReq(struct req *req, enum pool_how how)
 {
 	struct sess *sp;
 	struct sesspool *pp;
@@ -258,7 +260,9 @@ SES_ScheduleReq(struct req *req)
 	sp->task.func = ses_req_pool_task;
 	sp->task.priv = req;
 
-	if (Pool_Task(pp->pool, &sp->task, POOL_QUEUE_FRONT)) {
+	if (Pool_Task(pp->pool, &sp->task, how)) {
+		if (how == POOL_NO_QUEUE)
+			return (1);
 		AN (req->vcl);
 		VCL_Rel(&req->vcl);
 		SES_Delete(sp, SC_OVERLOAD, NAN);
@@ -267,6 +271,19 @@ SES_ScheduleReq(struct req *req)
 	return (0);
 }
 
+/*--------------------------------------------------------------------
+ * Run a request coming off a waiting list on the calling worker thread
+ */
+
+void
+SES_RunReq(struct worker *wrk, struct req *req)
+{
+
+	CHECK_OBJ_NOTNULL(wrk, WORKER_MAGIC);
+	WS_Reset(wrk->aws, NULL);
+	ses_req_pool_task(wrk, req);
+}
+
 /*--------------------------------------------------------------------
  * Handle a session (from waiter)
  */
@@ -367,19 +384,19 @@ SES_GetReq(struct worker *wrk, struct sess *sp)
 	assert(p < e);
 
 	nhttp = (uint16_t)cache_param->http_max_hdr;
-	hl = HTTP_estimate(nhttp);
+	hl = HTTP_estimate(nhttp, 1);
 
-	req->http = HTTP_create(p, nhttp);
+	req->http = HTTP_create(p, nhttp, 1);
 	p += hl;
 	p = (void*)PRNDUP(p);
 	assert(p < e);
 
-	req->http0 = HTTP_create(p, nhttp);
+	req->http0 = HTTP_create(p, nhttp, 1);
 	p += hl;
 	p = (void*)PRNDUP(p);
 	assert(p < e);
 
-	req->resp = HTTP_create(p, nhttp);
+	req->resp = HTTP_create(p, nhttp, 1);
 	p += hl;
 	p = (void*)PRNDUP(p);
 	assert(p < e);
@@ -387,7 +404,7 @@ SES_GetReq(struct worker *wrk, struct sess *sp)
 	sz = cache_param->workspace_thread;
 	VSL_Setup(req->vsl, p, sz);
 	req->vsl->wid = VXID_Get(&wrk->vxid_pool) | VSL_CLIENTMARKER;
-	VSLb(req->vsl, SLT_Begin, "req %u", sp->vxid & VSL_IDENTMASK);
+	VSLbu(req->vsl, SLT_Begin, "req ", sp->vxid & VSL_IDENTMASK);
 	VSL(SLT_Link, req->sp->vxid, "req %u", req->vsl->wid & VSL_IDENTMASK);
 	p += sz;
 	p = (void*)PRNDUP(p);
@@ -424,7 +441,7 @@ SES_ReleaseReq(struct req *req)
 	MPL_AssertSane(req);
 	if (req->vsl->wid != 0)
 		/* Non-released VXID - assume it was from a req */
-		VSLb(req->vsl, SLT_End, "%s", "");
+		VSLbs(req->vsl, SLT_End, "");
 	VSL_Flush(req->vsl, 0);
 	req->sp = NULL;
 	MPL_Free(pp->mpl_req, req);
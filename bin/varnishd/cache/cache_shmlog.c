@@ -29,28 +29,80 @@
 
 #include "config.h"
 
+#include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <unistd.h>
 
 #include "cache.h"
 #include "common/heritage.h"
 
 #include "cache_backend.h"	// For wrk->vbc
 
+#include "vcli.h"
+#include "vcli_priv.h"
 #include "vmb.h"
 #include "vtim.h"
 
 /* These cannot be struct lock, which depends on vsm/vsl working */
 static pthread_mutex_t vsl_mtx;
+static pthread_cond_t vsl_cond;		/* Signalled on wrap */
 static pthread_mutex_t vsm_mtx;
 
 static struct VSL_head		*vsl_head;
 static const uint32_t		*vsl_end;
-static uint32_t			*vsl_ptr;
 static unsigned			vsl_segment;
 static ssize_t			vsl_segsize;
 static unsigned			vsl_seq;
 
+/*
+ * Space in the log is reserved without vsl_mtx:  vsl_word holds the
+ * generation (bumped on every wrap) in the top 32 bits and the offset
+ * of the next record in the bottom 32 bits, and a writer claims its
+ * words with a single fetch-and-add.
+ *
+ * Readers stop at VSL_ENDMARKER, so nothing may be written into a part
+ * of the log before it has been filled with VSL_ENDMARKER.  vsl_clear
+ * is how far that has been done in generation vsl_clear_gen, and the
+ * writer crossing into a new segment clears the next one in advance.
+ *
+ * Segment crossings and the wrap are rare and happen under vsl_mtx.
+ *
+ * A writer which got descheduled long enough for the log to come round
+ * to its reservation again would write over the new generation, so the
+ * wrap waits until every word handed out in the old generation has been
+ * committed, as counted in vsl_done[].
+ */
+static volatile uint64_t	vsl_word;
+static volatile unsigned	vsl_clear_gen;
+static volatile unsigned	vsl_clear;
+static unsigned			vsl_gen;	/* Under vsl_mtx */
+static unsigned			vsl_clseg;	/* Next segment to clear */
+static unsigned			vsl_booked;	/* Segments set this gen */
+static volatile unsigned	vsl_done[2];	/* Words committed, by gen */
+static volatile unsigned	vsl_wrapping;
+
+#ifndef HAVE_SYNC_ATOMICS64
+static pthread_mutex_t vsl_word_mtx;
+#endif
+
+/*
+ * Counters are kept per thread, and folded into VSC_C_main every
+ * VSL_STAT_FOLD writes, when vsl_mtx is taken anyway and from VSL_Fold().
+ */
+#define VSL_STAT_FOLD		64
+
+struct vsl_stat {
+	unsigned		magic;
+#define VSL_STAT_MAGIC		0x1b7c5e42
+	unsigned		writes;
+	unsigned		records;
+	unsigned		flushes;
+	unsigned		cont;
+};
+
+static pthread_key_t		vsl_stat_key;
+
 struct VSC_C_main       *VSC_C_main;
 
 /*--------------------------------------------------------------------
@@ -89,84 +141,338 @@ vsl_hdr(enum VSL_tag_e tag, uint32_t *p, unsigned len, uint32_t vxid)
 }
 
 /*--------------------------------------------------------------------
- * Wrap the VSL buffer
+ * Per thread counters
  */
 
 static void
-vsl_wrap(void)
+vsl_stat_fold(struct vsl_stat *vs)
 {
 
-	assert(vsl_ptr >= vsl_head->log);
-	assert(vsl_ptr < vsl_end);
-	vsl_head->log[0] = VSL_ENDMARKER;
-	do
-		vsl_seq++;
-	while (vsl_seq == 0);
-	vsl_head->seq = vsl_seq;
-	vsl_head->segments[0] = 0;
-	VWMB();
-	if (vsl_ptr != vsl_head->log) {
-		*vsl_ptr = VSL_WRAPMARKER;
-		vsl_ptr = vsl_head->log;
+	CHECK_OBJ_NOTNULL(vs, VSL_STAT_MAGIC);
+	VSC_C_main->shm_writes += vs->writes;
+	VSC_C_main->shm_records += vs->records;
+	VSC_C_main->shm_flushes += vs->flushes;
+	VSC_C_main->shm_cont += vs->cont;
+	vs->writes = vs->records = vs->flushes = vs->cont = 0;
+}
+
+static void
+vsl_stat_free(void *priv)
+{
+	struct vsl_stat *vs;
+
+	CAST_OBJ_NOTNULL(vs, priv, VSL_STAT_MAGIC);
+	AZ(pthread_mutex_lock(&vsl_mtx));
+	vsl_stat_fold(vs);
+	AZ(pthread_mutex_unlock(&vsl_mtx));
+	FREE_OBJ(vs);
+}
+
+static struct vsl_stat *
+vsl_stat(void)
+{
+	struct vsl_stat *vs;
+
+	vs = pthread_getspecific(vsl_stat_key);
+	if (vs == NULL) {
+		ALLOC_OBJ(vs, VSL_STAT_MAGIC);
+		AN(vs);
+		AZ(pthread_setspecific(vsl_stat_key, vs));
 	}
-	vsl_segment = 0;
-	vsl_head->segment = vsl_segment;
-	VSC_C_main->shm_cycles++;
+	CHECK_OBJ(vs, VSL_STAT_MAGIC);
+	return (vs);
 }
 
 /*--------------------------------------------------------------------
- * Reserve bytes for a record, wrap if necessary
+ * Take vsl_mtx, counting contention, and fold our counters while at it
  */
 
-static uint32_t *
-vsl_get(unsigned len, unsigned records, unsigned flushes)
+static void
+vsl_lock(struct vsl_stat *vs)
 {
-	uint32_t *p;
 	int err;
-	unsigned old_segment;
 
 	err = pthread_mutex_trylock(&vsl_mtx);
 	if (err == EBUSY) {
 		AZ(pthread_mutex_lock(&vsl_mtx));
-		VSC_C_main->shm_cont++;
+		vs->cont++;
 	} else {
 		AZ(err);
 	}
-	assert(vsl_ptr < vsl_end);
-	assert(((uintptr_t)vsl_ptr & 0x3) == 0);
+	vsl_stat_fold(vs);
+}
 
-	VSC_C_main->shm_writes++;
-	VSC_C_main->shm_flushes += flushes;
-	VSC_C_main->shm_records += records;
+/*
+ * Called by worker threads when they go idle.  Busy workers fold every
+ * VSL_STAT_FOLD writes, without vsl_mtx between their tasks.
+ */
 
-	/* Wrap if necessary */
-	if (VSL_END(vsl_ptr, len) >= vsl_end)
-		vsl_wrap();
+void
+VSL_Fold(void)
+{
+	struct vsl_stat *vs;
 
-	p = vsl_ptr;
-	vsl_ptr = VSL_END(vsl_ptr, len);
-	assert(vsl_ptr < vsl_end);
-	assert(((uintptr_t)vsl_ptr & 0x3) == 0);
+	vs = pthread_getspecific(vsl_stat_key);
+	if (vs == NULL || vs->writes == 0)
+		return;
+	vsl_lock(vs);
+	AZ(pthread_mutex_unlock(&vsl_mtx));
+}
 
-	*vsl_ptr = VSL_ENDMARKER;
+/*--------------------------------------------------------------------
+ * Operations on vsl_word
+ */
 
-	old_segment = vsl_segment;
-	while ((vsl_ptr - vsl_head->log) / vsl_segsize > vsl_segment) {
-		if (vsl_segment == VSL_SEGMENTS - 1)
-			break;
-		vsl_segment++;
-		vsl_head->segments[vsl_segment] = vsl_ptr - vsl_head->log;
+static uint64_t
+vsl_word_add(unsigned n)
+{
+#ifdef HAVE_SYNC_ATOMICS64
+	return (__sync_fetch_and_add(&vsl_word, n));
+#else
+	uint64_t w;
+
+	AZ(pthread_mutex_lock(&vsl_word_mtx));
+	w = vsl_word;
+	vsl_word += n;
+	AZ(pthread_mutex_unlock(&vsl_word_mtx));
+	return (w);
+#endif
+}
+
+static void
+vsl_word_set(unsigned gen, unsigned off)
+{
+	uint64_t w, nw;
+
+	nw = ((uint64_t)gen << 32) | off;
+#ifdef HAVE_SYNC_ATOMICS64
+	do
+		w = vsl_word;
+	while (!__sync_bool_compare_and_swap(&vsl_word, w, nw));
+#else
+	(void)w;
+	AZ(pthread_mutex_lock(&vsl_word_mtx));
+	vsl_word = nw;
+	AZ(pthread_mutex_unlock(&vsl_word_mtx));
+#endif
+}
+
+/*--------------------------------------------------------------------
+ * Count a record as committed, and wake vsl_wrap() if it is waiting
+ */
+
+static void
+vsl_commit(unsigned gen, unsigned len)
+{
+	unsigned n;
+
+	n = 2 + VSL_WORDS(len);
+#ifdef HAVE_SYNC_ATOMICS64
+	(void)__sync_fetch_and_add(&vsl_done[gen & 1], n);
+#else
+	AZ(pthread_mutex_lock(&vsl_word_mtx));
+	vsl_done[gen & 1] += n;
+	AZ(pthread_mutex_unlock(&vsl_word_mtx));
+	VMB();
+#endif
+	if (vsl_wrapping) {
+		AZ(pthread_mutex_lock(&vsl_mtx));
+		AZ(pthread_cond_broadcast(&vsl_cond));
+		AZ(pthread_mutex_unlock(&vsl_mtx));
 	}
-	if (old_segment != vsl_segment) {
-		/* Write memory barrier to ensure ENDMARKER and new table
-		   values are seen before new segment number */
+}
+
+/*--------------------------------------------------------------------
+ * Fill segments with VSL_ENDMARKER, up to and including segment 'seg'
+ */
+
+static void
+vsl_clearto(unsigned seg)
+{
+	uint32_t *p, *e;
+
+	if (seg >= VSL_SEGMENTS)
+		seg = VSL_SEGMENTS - 1;
+	for (; vsl_clseg <= seg; vsl_clseg++) {
+		p = vsl_head->log + vsl_clseg * vsl_segsize;
+		if (vsl_clseg == VSL_SEGMENTS - 1)
+			e = TRUST_ME(vsl_end);
+		else
+			e = p + vsl_segsize;
+		while (p < e)
+			*p++ = VSL_ENDMARKER;
 		VWMB();
-		vsl_head->segment = vsl_segment;
+		vsl_clear = e - vsl_head->log;
 	}
+}
+
+static unsigned
+vsl_segno(unsigned off)
+{
+	unsigned seg;
+
+	seg = off / vsl_segsize;
+	if (seg >= VSL_SEGMENTS)
+		/* Rounding error spills to last segment */
+		seg = VSL_SEGMENTS - 1;
+	return (seg);
+}
 
+/*--------------------------------------------------------------------
+ * Wrap the VSL buffer.
+ *
+ * Called by the one writer whose reservation [off...off+n] straddles
+ * the end of the log, it hands out the front of the log to itself.
+ */
+
+static void
+vsl_wrap(struct vsl_stat *vs, unsigned gen, unsigned off, unsigned n)
+{
+	unsigned u;
+
+	vsl_lock(vs);
+	assert(gen == vsl_gen);
+	assert(off < vsl_end - vsl_head->log);
+	AN(off);
+
+	/* Wait for everybody who got space before us, see vsl_commit() */
+	vsl_wrapping = 1;
+	VMB();
+	while (vsl_done[gen & 1] != off)
+		AZ(pthread_cond_wait(&vsl_cond, &vsl_mtx));
+	vsl_wrapping = 0;
+	vsl_done[(gen + 1) & 1] = 0;
+
+	/* Writers still working in this generation must not wait */
+	vsl_clearto(VSL_SEGMENTS);
+
+	/* Segments nobody got around to set, are no longer valid */
+	for (u = 1; u < VSL_SEGMENTS; u++)
+		if (!(vsl_booked & (1U << u)))
+			vsl_head->segments[u] = -1;
+
+	vsl_clear = 0;
+	VWMB();
+	vsl_clear_gen = ++vsl_gen;
+	vsl_booked = 1;
+	vsl_clseg = 0;
+	vsl_clearto(1);
+
+	do
+		vsl_seq++;
+	while (vsl_seq == 0);
+	vsl_head->seq = vsl_seq;
+	vsl_head->segments[0] = 0;
+	VWMB();
+	vsl_head->log[off] = VSL_WRAPMARKER;
+	vsl_segment = 0;
+	vsl_head->segment = vsl_segment;
+	VSC_C_main->shm_cycles++;
+
+	VWMB();
+	vsl_word_set(vsl_gen, n);
+	AZ(pthread_cond_broadcast(&vsl_cond));
+	AZ(pthread_mutex_unlock(&vsl_mtx));
+}
+
+/*--------------------------------------------------------------------
+ * Wait for the writer which wraps generation 'gen'
+ */
+
+static void
+vsl_wait(struct vsl_stat *vs, unsigned gen)
+{
+
+	vsl_lock(vs);
+	while ((unsigned)(vsl_word >> 32) == gen)
+		AZ(pthread_cond_wait(&vsl_cond, &vsl_mtx));
 	AZ(pthread_mutex_unlock(&vsl_mtx));
+}
+
+/*--------------------------------------------------------------------
+ * Our record ends in a new segment:  Update the segment table and clear
+ * the segment after it.  Also the slow path for when the clearing has
+ * not kept up with us.
+ */
+
+static void
+vsl_segments(struct vsl_stat *vs, unsigned gen, unsigned off, unsigned end)
+{
+	unsigned u, seg;
+
+	vsl_lock(vs);
+	if (gen == vsl_gen) {
+		seg = vsl_segno(end);
+		for (u = vsl_segno(off) + 1; u <= seg; u++) {
+			vsl_head->segments[u] = end;
+			vsl_booked |= 1U << u;
+		}
+		vsl_clearto(seg + 1);
+		if (seg > vsl_segment) {
+			/* Write memory barrier to ensure ENDMARKER and new
+			   table values are seen before new segment number */
+			VWMB();
+			vsl_segment = seg;
+			vsl_head->segment = vsl_segment;
+		}
+		assert(end < vsl_clear);
+	}
+	AZ(pthread_mutex_unlock(&vsl_mtx));
+}
+
+/*--------------------------------------------------------------------
+ * Reserve bytes for a record, wrap if necessary
+ *
+ * An older generation than vsl_clear_gen has been cleared all the way,
+ * see vsl_wrap().
+ */
+
+static uint32_t *
+vsl_get(unsigned len, unsigned records, unsigned flushes, unsigned *pgen)
+{
+	struct vsl_stat *vs;
+	uint64_t w;
+	unsigned gen, off, end, n, lim;
 
-	return (p);
+	vs = vsl_stat();
+	vs->writes++;
+	vs->records += records;
+	vs->flushes += flushes;
+
+	n = 2 + VSL_WORDS(len);
+	lim = vsl_end - vsl_head->log;
+	while (1) {
+		w = vsl_word_add(n);
+		gen = (unsigned)(w >> 32);
+		off = (unsigned)w;
+		if (off + n < lim)
+			break;
+		if (off < lim) {
+			vsl_wrap(vs, gen, off, n);
+			gen++;
+			off = 0;
+			break;
+		}
+		vsl_wait(vs, gen);
+	}
+
+	end = off + n;
+	if (vsl_segno(off) != vsl_segno(end)) {
+		vsl_segments(vs, gen, off, end);
+	} else if (gen == vsl_clear_gen) {
+		VRMB();
+		if (end >= vsl_clear)
+			vsl_segments(vs, gen, off, end);
+	}
+
+	if (vs->writes >= VSL_STAT_FOLD &&
+	    !pthread_mutex_trylock(&vsl_mtx)) {
+		vsl_stat_fold(vs);
+		AZ(pthread_mutex_unlock(&vsl_mtx));
+	}
+
+	*pgen = gen;
+	return (vsl_head->log + off);
 }
 
 /*--------------------------------------------------------------------
@@ -177,7 +483,7 @@ static void
 vslr(enum VSL_tag_e tag, uint32_t vxid, const char *b, unsigned len)
 {
 	uint32_t *p;
-	unsigned mlen;
+	unsigned mlen, gen;
 
 	mlen = cache_param->shm_reclen;
 
@@ -185,7 +491,7 @@ vslr(enum VSL_tag_e tag, uint32_t vxid, const char *b, unsigned len)
 	if (len > mlen)
 		len = mlen;
 
-	p = vsl_get(len, 1, 0);
+	p = vsl_get(len, 1, 0, &gen);
 
 	memcpy(p + 2, b, len);
 
@@ -196,6 +502,7 @@ vslr(enum VSL_tag_e tag, uint32_t vxid, const char *b, unsigned len)
 	p[1] = vxid;
 	VWMB();
 	(void)vsl_hdr(tag, p, len, vxid);
+	vsl_commit(gen, len);
 }
 
 /*--------------------------------------------------------------------
@@ -235,7 +542,7 @@ void
 VSL_Flush(struct vsl_log *vsl, int overflow)
 {
 	uint32_t *p;
-	unsigned l;
+	unsigned l, gen;
 
 	l = pdiff(vsl->wlb, vsl->wlp);
 	if (l == 0)
@@ -243,32 +550,30 @@ VSL_Flush(struct vsl_log *vsl, int overflow)
 
 	assert(l >= 8);
 
-	p = vsl_get(l, vsl->wlr, overflow);
+	p = vsl_get(l, vsl->wlr, overflow, &gen);
 
 	memcpy(p + 2, vsl->wlb, l);
 	p[1] = l;
 	VWMB();
 	p[0] = ((((unsigned)SLT__Batch & 0xff) << 24) | 0);
+	vsl_commit(gen, l);
 	vsl->wlp = vsl->wlb;
 	vsl->wlr = 0;
 }
 
 /*--------------------------------------------------------------------
- * VSL-buffered-txt
+ * Copy a record into the VSL buffer, the tag must already be checked
+ * against the mask.
  */
 
-void
-VSLbt(struct vsl_log *vsl, enum VSL_tag_e tag, txt t)
+static void
+vslb_put(struct vsl_log *vsl, enum VSL_tag_e tag, const char *b, unsigned l)
 {
-	unsigned l, mlen;
+	unsigned mlen;
 
-	Tcheck(t);
-	if (vsl_tag_is_masked(tag))
-		return;
 	mlen = cache_param->shm_reclen;
 
 	/* Truncate */
-	l = Tlen(t);
 	if (l > mlen)
 		l = mlen;
 
@@ -278,7 +583,7 @@ VSLbt(struct vsl_log *vsl, enum VSL_tag_e tag, txt t)
 	if (VSL_END(vsl->wlp, l) >= vsl->wle)
 		VSL_Flush(vsl, 1);
 	assert(VSL_END(vsl->wlp, l) < vsl->wle);
-	memcpy(VSL_DATA(vsl->wlp), t.b, l);
+	memcpy(VSL_DATA(vsl->wlp), b, l);
 	vsl->wlp = vsl_hdr(tag, vsl->wlp, l, vsl->wid);
 	assert(vsl->wlp < vsl->wle);
 	vsl->wlr++;
@@ -287,6 +592,127 @@ VSLbt(struct vsl_log *vsl, enum VSL_tag_e tag, txt t)
 		VSL_Flush(vsl, 0);
 }
 
+/*--------------------------------------------------------------------
+ * Lay down decimal digits, return the number of chars
+ */
+
+static unsigned
+vsl_utoa(char *p, uintmax_t u, unsigned mindig)
+{
+	char buf[24], *q;
+	unsigned l;
+
+	q = buf + sizeof buf;
+	do {
+		*--q = '0' + (u % 10);
+		u /= 10;
+	} while (u > 0 || buf + sizeof buf - q < mindig);
+	l = buf + sizeof buf - q;
+	memcpy(p, q, l);
+	return (l);
+}
+
+/*--------------------------------------------------------------------
+ * VSL-buffered-txt
+ */
+
+void
+VSLbt(struct vsl_log *vsl, enum VSL_tag_e tag, txt t)
+{
+
+	Tcheck(t);
+	if (vsl_tag_is_masked(tag))
+		return;
+	vslb_put(vsl, tag, t.b, Tlen(t));
+}
+
+/*--------------------------------------------------------------------
+ * VSL-buffered-string, for VSLb(vsl, tag, "%s", s)
+ */
+
+void
+VSLbs(struct vsl_log *vsl, enum VSL_tag_e tag, const char *s)
+{
+
+	if (vsl_tag_is_masked(tag))
+		return;
+	if (s == NULL)
+		s = "(null)";	/* As printf(3) does, VCL can hash NULL */
+	vslb_put(vsl, tag, s, strlen(s));
+}
+
+/*--------------------------------------------------------------------
+ * VSL-buffered-unsigned, for VSLb(vsl, tag, "%ju", u) with an optional
+ * prefix, ("bereq %u" is VSLbu(vsl, tag, "bereq ", u))
+ */
+
+void
+VSLbu(struct vsl_log *vsl, enum VSL_tag_e tag, const char *pfx, uintmax_t u)
+{
+	char buf[64];
+	unsigned l = 0;
+
+	if (vsl_tag_is_masked(tag))
+		return;
+	if (pfx != NULL) {
+		l = strlen(pfx);
+		assert(l < sizeof buf - 24);
+		memcpy(buf, pfx, l);
+	}
+	l += vsl_utoa(buf + l, u, 1);
+	vslb_put(vsl, tag, buf, l);
+}
+
+/*--------------------------------------------------------------------
+ * VSL-buffered-timestamps, for VSLb(vsl, tag, "%.9f %.9f ...", ...)
+ *
+ * The fraction is rounded from a double, so the last digit can differ
+ * from printf(3) for values within an ulp of a rounding boundary.
+ * NAN and absurd values are printed with "%.9g".
+ */
+
+#define VSL_TS_MAX		8
+
+void
+VSLbts(struct vsl_log *vsl, enum VSL_tag_e tag, const double *t, unsigned n)
+{
+	char buf[VSL_TS_MAX * 32], *p;
+	double d, i;
+	uint64_t f;
+	unsigned u;
+
+	if (vsl_tag_is_masked(tag))
+		return;
+	AN(t);
+	assert(n > 0 && n <= VSL_TS_MAX);
+	p = buf;
+	for (u = 0; u < n; u++) {
+		d = t[u];
+		if (u > 0)
+			*p++ = ' ';
+		if (isnan(d) || fabs(d) >= 1e18) {
+			/* Unset or bogus timestamps, not worth optimizing */
+			p += snprintf(p, 32, "%.9g", d);
+			continue;
+		}
+		if (d < 0) {
+			*p++ = '-';
+			d = -d;
+		}
+		i = floor(d);
+		f = (uint64_t)((d - i) * 1e9 + .5);
+		if (f >= 1000000000) {
+			i += 1.;
+			f -= 1000000000;
+		}
+		p += vsl_utoa(p, (uintmax_t)i, 1);
+		*p++ = '.';
+		p += vsl_utoa(p, f, 9);
+	}
+	assert(p <= buf + sizeof buf);
+	vslb_put(vsl, tag, buf, p - buf);
+}
+
 /*--------------------------------------------------------------------
  * VSL-buffered
  */
@@ -359,6 +785,97 @@ VSL_Setup(struct vsl_log *vsl, void *ptr, size_t len)
 	vsl->wid = 0;
 }
 
+/*--------------------------------------------------------------------
+ * Microbenchmark:  N threads writing unbuffered records into the live
+ * log as fast as they can.
+ */
+
+struct vsl_bench {
+	unsigned		magic;
+#define VSL_BENCH_MAGIC		0x5d0e3a71
+	unsigned		nrec;
+	double			t;
+};
+
+static void *
+vsl_bench_thread(void *priv)
+{
+	struct vsl_bench *vb;
+	unsigned u;
+	double t0;
+
+	CAST_OBJ_NOTNULL(vb, priv, VSL_BENCH_MAGIC);
+	THR_SetName("vsl_bench");
+	t0 = VTIM_mono();
+	for (u = 0; u < vb->nrec; u++)
+		vslr(SLT_Debug, 0, "vsl_bench", 9);
+	vb->t = VTIM_mono() - t0;
+	return (NULL);
+}
+
+static void
+vsl_bench(struct cli *cli, const char * const *av, void *priv)
+{
+	struct vsl_bench *vb;
+	pthread_t *tp;
+	unsigned u, nthr = 1, nrec = 1000000;
+	long ncpu;
+	double t0, t, tt = 0, n;
+
+	(void)priv;
+	if (av[2] != NULL) {
+		nthr = strtoul(av[2], NULL, 0);
+		if (av[3] != NULL)
+			nrec = strtoul(av[3], NULL, 0);
+	}
+	if (nthr < 1 || nthr > 256 || nrec < 1) {
+		VCLI_Out(cli, "Need 1...256 threads and at least one record");
+		VCLI_SetResult(cli, CLIS_PARAM);
+		return;
+	}
+	vb = calloc(nthr, sizeof *vb);
+	AN(vb);
+	tp = calloc(nthr, sizeof *tp);
+	AN(tp);
+	t0 = VTIM_mono();
+	for (u = 0; u < nthr; u++) {
+		vb[u].magic = VSL_BENCH_MAGIC;
+		vb[u].nrec = nrec;
+		AZ(pthread_create(&tp[u], NULL, vsl_bench_thread, &vb[u]));
+	}
+	for (u = 0; u < nthr; u++) {
+		AZ(pthread_join(tp[u], NULL));
+		tt += vb[u].t;
+	}
+	t = VTIM_mono() - t0;
+	free(tp);
+	free(vb);
+
+	ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+	if (ncpu < 1 || ncpu > nthr)
+		ncpu = nthr;
+	n = (double)nthr * nrec;
+	VCLI_Out(cli, "%u threads, %u records each, %.3f s\n",
+	    nthr, nrec, t);
+	VCLI_Out(cli, "%.0f records/s, %.0f records/s/core (%ld cores)\n",
+	    n / t, n / t / ncpu, ncpu);
+	VCLI_Out(cli, "%.1f ns/record in each thread", 1e9 * tt / n);
+}
+
+static struct cli_proto vsl_cmds[] = {
+	{ "debug.vsl_bench", "debug.vsl_bench [threads [records]]",
+		"\tBenchmark writing records to the shared memory log\n",
+		0, 2, "d", vsl_bench },
+	{ NULL }
+};
+
+void
+VSL_Init(void)
+{
+
+	CLI_AddFuncs(vsl_cmds);
+}
+
 /*--------------------------------------------------------------------*/
 
 static void *
@@ -384,7 +901,12 @@ VSM_Init(void)
 	pthread_t tp;
 
 	AZ(pthread_mutex_init(&vsl_mtx, NULL));
+	AZ(pthread_cond_init(&vsl_cond, NULL));
 	AZ(pthread_mutex_init(&vsm_mtx, NULL));
+#ifndef HAVE_SYNC_ATOMICS64
+	AZ(pthread_mutex_init(&vsl_word_mtx, NULL));
+#endif
+	AZ(pthread_key_create(&vsl_stat_key, vsl_stat_free));
 
 	vsl_head = VSM_Alloc(cache_param->vsl_space, VSL_CLASS, "", "");
 	AN(vsl_head);
@@ -397,8 +919,8 @@ VSM_Init(void)
 	vsl_head->segments[0] = 0;
 	for (i = 1; i < VSL_SEGMENTS; i++)
 		vsl_head->segments[i] = -1;
-	vsl_ptr = vsl_head->log;
-	*vsl_ptr = VSL_ENDMARKER;
+	vsl_booked = 1;
+	vsl_clearto(1);
 
 	VWMB();
 	do
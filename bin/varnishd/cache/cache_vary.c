@@ -223,7 +223,7 @@ vry_cmp(const uint8_t *v1, const uint8_t *v2)
 void
 VRY_Prep(struct req *req)
 {
-	if (req->hash_objhead == NULL) {
+	if (req->hash_objhead == NULL && req->hash_objcore == NULL) {
 		/* Not a waiting list return */
 		AZ(req->vary_b);
 		AZ(req->vary_l);
@@ -352,6 +352,129 @@ VRY_Match(struct req *req, const uint8_t *vary)
 	}
 }
 
+/**********************************************************************
+ * Vary index
+ *
+ * The objhead remembers the headers its first variant varies on, and
+ * variants which vary on the same headers are tagged with a hash of
+ * their vary matching string.  A lookup hashes the request on those
+ * headers once, and needs only look at the variants with that hash.
+ *
+ * Accept-Encoding contents are left out of the hash, vry_cmp() decides
+ * on them at check time.
+ */
+
+static uint32_t
+vry_hash(uint32_t h, const void *ptr, unsigned len)
+{
+	const uint8_t *p = ptr;
+
+	/* FNV-1a */
+	while (len-- > 0) {
+		h ^= *p++;
+		h *= 16777619;
+	}
+	return (h);
+}
+
+static uint32_t
+vry_hash_entry(uint32_t h, const uint8_t *vary, const char *v, unsigned l)
+{
+	uint8_t b[2];
+
+	h = vry_hash(h, vary + 2, vary[2] + 2);
+	if (!strcasecmp(H_Accept_Encoding, (const char*)vary + 2))
+		return (h);
+	vbe16enc(b, (uint16_t)l);
+	h = vry_hash(h, b, 2);
+	if (l != 0xffff)
+		h = vry_hash(h, v, l);
+	return (h);
+}
+
+/*
+ * Hash a vary matching string
+ */
+
+uint32_t
+VRY_Hash(const uint8_t *vary)
+{
+	uint32_t h = 2166136261U;
+
+	AN(vary);
+	while (vary[2]) {
+		h = vry_hash_entry(h, vary,
+		    (const char *)vary + 2 + vary[2] + 2, vbe16dec(vary));
+		vary += vry_len(vary);
+	}
+	return (h);
+}
+
+/*
+ * Hash the request, as if it had built a vary matching string with the
+ * headers from 'vary'.
+ */
+
+uint32_t
+VRY_ReqHash(const struct req *req, const uint8_t *vary)
+{
+	uint32_t h = 2166136261U;
+	char *v, *e;
+
+	CHECK_OBJ_NOTNULL(req, REQ_MAGIC);
+	AN(vary);
+	while (vary[2]) {
+		if (http_GetHdr(req->http, (const char*)(vary + 2), &v)) {
+			/* Trim trailing space, like VRY_Match() */
+			e = strchr(v, '\0');
+			while (e > v && vct_issp(e[-1]))
+				e--;
+			h = vry_hash_entry(h, vary, v, e - v);
+		} else
+			h = vry_hash_entry(h, vary, NULL, 0xffff);
+		vary += vry_len(vary);
+	}
+	return (h);
+}
+
+/*
+ * Check that two vary matching strings are on the same headers
+ */
+
+int
+VRY_SameHeaders(const uint8_t *v1, const uint8_t *v2)
+{
+
+	AN(v1);
+	AN(v2);
+	while (v1[2] && v2[2]) {
+		if (memcmp(v1 + 2, v2 + 2, v1[2] + 2))
+			return (0);
+		v1 += vry_len(v1);
+		v2 += vry_len(v2);
+	}
+	return (v1[2] == v2[2]);
+}
+
+/*
+ * Copy a vary matching string, for the objhead to keep
+ */
+
+uint8_t *
+VRY_Dup(const uint8_t *vary)
+{
+	const uint8_t *p;
+	uint8_t *d;
+
+	AN(vary);
+	for (p = vary; p[2]; p += vry_len(p))
+		continue;
+	d = malloc((p + 3) - vary);
+	if (d != NULL)
+		memcpy(d, vary, (p + 3) - vary);
+	return (d);
+}
+
 void
 VRY_Validate(const uint8_t *vary)
 {
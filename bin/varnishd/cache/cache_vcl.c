@@ -420,9 +420,9 @@ vcl_call_method(struct worker *wrk, struct req *req, struct busyobj *bo,
 	wrk->handling = 0;
 	wrk->cur_method = method;
 	AN(vsl);
-	VSLb(vsl, SLT_VCL_call, "%s", VCL_Method_Name(method));
+	VSLbs(vsl, SLT_VCL_call, VCL_Method_Name(method));
 	(void)func(&ctx);
-	VSLb(vsl, SLT_VCL_return, "%s", VCL_Return_Name(wrk->handling));
+	VSLbs(vsl, SLT_VCL_return, VCL_Return_Name(wrk->handling));
 	wrk->cur_method = 0;
 	WS_Reset(wrk->aws, aws);
 }
@@ -88,7 +88,7 @@ VRT_acl_log(const struct vrt_ctx *ctx, const char *msg)
 {
 
 	CHECK_OBJ_NOTNULL(ctx, VRT_CTX_MAGIC);
-	VSLb(ctx->vsl, SLT_VCL_acl, "%s", msg);
+	VSLbs(ctx->vsl, SLT_VCL_acl, msg);
 }
 
 /*--------------------------------------------------------------------*/
@@ -236,7 +236,7 @@ VRT_SetHdr(const struct vrt_ctx *ctx , const struct gethdr_s *hs,
 	} else {
 		b = VRT_String(hp->ws, hs->what + 1, p, ap);
 		if (b == NULL) {
-			VSLb(ctx->vsl, SLT_LostHeader, "%s", hs->what + 1);
+			VSLbs(ctx->vsl, SLT_LostHeader, hs->what + 1);
 		} else {
 			http_Unset(hp, hs->what);
 			http_SetHeader(hp, b);
@@ -275,7 +275,7 @@ VRT_hashdata(const struct vrt_ctx *ctx, const char *str, ...)
 		if (p == vrt_magic_string_end)
 			break;
 		HSH_AddString(ctx->req, p);
-		VSLb(ctx->vsl, SLT_Hash, "%s", str);
+		VSLbs(ctx->vsl, SLT_Hash, str);
 	}
 	/*
 	 * Add a 'field-separator' to make it more difficult to
@@ -56,7 +56,7 @@ vrt_do_string(const struct http *hp, int fld,
 	AN(hp);
 	b = VRT_String(hp->ws, NULL, p, ap);
 	if (b == NULL || *b == '\0') {
-		VSLb(hp->vsl, SLT_LostHeader, "%s", err);
+		VSLbs(hp->vsl, SLT_LostHeader, err);
 	} else {
 		http_SetH(hp, fld, b);
 	}
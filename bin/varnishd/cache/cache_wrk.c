@@ -158,6 +158,7 @@ void *
 WRK_thread(void *priv)
 {
 
+	Pool_Bind(priv);
 	return (wrk_thread_real(priv, cache_param->workspace_thread));
 }
 
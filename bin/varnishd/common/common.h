@@ -50,6 +50,17 @@ enum baninfo {
 	BI_DROP
 };
 
+/*
+ * Eviction policy of a stevedores LRU, selected with the "lru=" argument
+ * to -s in the manager and acted upon in the child.
+ */
+
+enum lru_policy {
+	LRU_CLASSIC = 0,
+	LRU_SLRU,
+	LRU_TINYLFU
+};
+
 struct cli;
 
 /**********************************************************************
@@ -38,6 +38,7 @@ struct listen_sock {
 	int				sock;
 	char				*name;
 	struct vss_addr			*addr;
+	unsigned			pool;
 };
 
 VTAILQ_HEAD(listen_sock_head, listen_sock);
@@ -55,6 +56,9 @@ struct heritage {
 	struct listen_sock_head		socks;
 	unsigned			nsocks;
 
+	/* Pools with their own SO_REUSEPORT copy of the sockets */
+	unsigned			sock_pools;
+
 	/* Hash method */
 	const struct hash_slinger	*hash;
 
@@ -87,6 +87,8 @@ struct params {
 	double			wthread_stats_rate;
 	ssize_t			wthread_stacksize;
 	unsigned		wthread_queue_limit;
+	double			wthread_queue_target;
+	unsigned		wthread_numa;
 
 	/* Memory allocation hints */
 	unsigned		workspace_client;
@@ -106,6 +108,7 @@ struct params {
 
 	double			timeout_linger;
 	double			timeout_idle;
+	unsigned		waiter_threads;
 	double			timeout_req;
 	unsigned		pipe_timeout;
 	unsigned		send_timeout;
@@ -122,6 +125,9 @@ struct params {
 	/* Fetcher hints */
 	ssize_t			fetch_chunksize;
 	ssize_t			fetch_maxchunksize;
+
+	/* Delivery hints */
+	ssize_t			delivery_prefetch;
 	unsigned		nuke_limit;
 
 	unsigned		accept_filter;
@@ -139,6 +145,7 @@ struct params {
 
 	/* LRU list ordering interval */
 	unsigned		lru_timeout;
+	unsigned		lru_protected;
 
 	/* Maximum restarts allowed */
 	unsigned		max_restarts;
@@ -154,6 +161,8 @@ struct params {
 
 	/* Rush exponent */
 	unsigned		rush_exponent;
+	unsigned		rush_coalesce;
+	unsigned		rush_stream;
 
 	/* Default connection_timeout */
 	double			connect_timeout;
@@ -176,6 +185,8 @@ struct params {
 
 	/* Expiry pacer parameters */
 	double			expiry_sleep;
+	unsigned		expiry_shards;
+	unsigned		expiry_batch;
 
 	/* Acceptor pacer parameters */
 	double			acceptor_sleep_max;
@@ -0,0 +1,460 @@
+/*-
+ * Copyright (c) 2013 Varnish Software AS
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * An open addressing hash with cache line sized buckets.
+ *
+ * Each bucket holds HBK_SLOTS objhead pointers and a 16 bit fingerprint
+ * of the digest for each of them, so a lookup normally touches a single
+ * cache line of the table and the one objhead it finds.  The fingerprints
+ * of a bucket are compared in one go.
+ *
+ * Collisions probe the following buckets.  Instead of tombstones, every
+ * bucket counts the entries which had to probe past it, a lookup stops
+ * at the first bucket where that count is zero.
+ *
+ * The table is split in HBK_NPART partitions on the top bits of the
+ * digest, each with its own lock.  A partition grows by allocating a
+ * table of twice the size and moving a few buckets over on every
+ * following operation, so no single lookup pays for the whole resize.
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "cache/cache.h"
+
+#include "hash/hash_slinger.h"
+#include "vcli_priv.h"
+#include "vend.h"
+
+#define HBK_SLOTS		6
+#define HBK_NPART		16
+#define HBK_MIGRATE		2	/* Buckets moved per operation */
+
+struct hbk_bucket {
+	uint16_t		fp[HBK_SLOTS];
+	uint16_t		overflow;
+	uint16_t		spare;
+	struct objhead		*oh[HBK_SLOTS];
+};
+
+struct hbk_tab {
+	struct hbk_bucket	*b;
+	uint64_t		mask;
+	uint64_t		n;
+};
+
+struct hbk_part {
+	unsigned		magic;
+#define HBK_PART_MAGIC		0x4c9b21e7
+	struct lock		mtx;
+	struct hbk_tab		cur;
+	struct hbk_tab		old;	/* Being migrated into cur */
+	uint64_t		mig;	/* Next bucket of old to move */
+	unsigned		nresize;
+};
+
+static uint64_t			hbk_nbucket = 1024;
+static struct hbk_part		hbk_part[HBK_NPART];
+
+/*--------------------------------------------------------------------
+ * The top bits of the digest pick the partition, the bottom bits of the
+ * same word the bucket, and the fingerprint comes from the next word.
+ */
+
+static uint64_t
+hbk_hash(const uint8_t *digest)
+{
+
+	return (vbe64dec(digest));
+}
+
+static uint16_t
+hbk_fp(const uint8_t *digest)
+{
+	uint16_t fp;
+
+	memcpy(&fp, digest + 8, sizeof fp);
+	return (fp == 0 ? 1 : fp);	/* Zero is an empty slot */
+}
+
+static struct hbk_part *
+hbk_getpart(uint64_t h)
+{
+	struct hbk_part *hp;
+
+	hp = &hbk_part[h >> 60];
+	CHECK_OBJ_NOTNULL(hp, HBK_PART_MAGIC);
+	return (hp);
+}
+
+/*--------------------------------------------------------------------
+ * Return a bitmap of the slots with this fingerprint
+ */
+
+static unsigned
+hbk_match(const struct hbk_bucket *b, uint16_t fp)
+{
+#if defined(__SSE2__)
+	__m128i v;
+	unsigned m, r, u;
+
+	v = _mm_loadu_si128((const void *)b->fp);
+	m = _mm_movemask_epi8(_mm_cmpeq_epi16(v, _mm_set1_epi16(fp)));
+	/* Two bits per lane, one per slot */
+	r = 0;
+	for (u = 0; u < HBK_SLOTS; u++)
+		if (m & (1U << (u * 2)))
+			r |= 1U << u;
+	return (r);
+#else
+	unsigned u, r;
+
+	r = 0;
+	for (u = 0; u < HBK_SLOTS; u++)
+		if (b->fp[u] == fp)
+			r |= 1U << u;
+	return (r);
+#endif
+}
+
+/*--------------------------------------------------------------------
+ * Operations on a single table
+ */
+
+static void
+hbk_tab_alloc(struct hbk_tab *t, uint64_t nbucket)
+{
+
+	assert(nbucket > 0 && !(nbucket & (nbucket - 1)));
+	t->b = calloc(nbucket, sizeof *t->b);
+	XXXAN(t->b);
+	t->mask = nbucket - 1;
+	t->n = 0;
+}
+
+static struct objhead *
+hbk_tab_find(const struct hbk_tab *t, uint64_t h, uint16_t fp,
+    const uint8_t *digest, uint64_t *pi, unsigned *ps)
+{
+	const struct hbk_bucket *b;
+	struct objhead *oh;
+	uint64_t i, n;
+	unsigned m, s;
+
+	if (t->b == NULL)
+		return (NULL);
+	i = h & t->mask;
+	for (n = 0; n <= t->mask; n++) {
+		b = &t->b[i];
+		m = hbk_match(b, fp);
+		for (s = 0; m != 0; s++, m >>= 1) {
+			if (!(m & 1))
+				continue;
+			oh = b->oh[s];
+			CHECK_OBJ_NOTNULL(oh, OBJHEAD_MAGIC);
+			if (memcmp(oh->digest, digest, sizeof oh->digest))
+				continue;
+			if (pi != NULL) {
+				*pi = i;
+				*ps = s;
+			}
+			return (oh);
+		}
+		if (b->overflow == 0)
+			break;
+		i = (i + 1) & t->mask;
+	}
+	return (NULL);
+}
+
+static void
+hbk_tab_put(struct hbk_tab *t, uint64_t h, uint16_t fp, struct objhead *oh)
+{
+	struct hbk_bucket *b;
+	uint64_t i, n;
+	unsigned m, s;
+
+	i = h & t->mask;
+	for (n = 0; n <= t->mask; n++) {
+		b = &t->b[i];
+		m = hbk_match(b, 0);
+		if (m != 0) {
+			for (s = 0; !(m & 1); s++)
+				m >>= 1;
+			AZ(b->oh[s]);
+			b->fp[s] = fp;
+			b->oh[s] = oh;
+			t->n++;
+			return;
+		}
+		assert(b->overflow < 0xffff);
+		b->overflow++;
+		i = (i + 1) & t->mask;
+	}
+	WRONG("hbk table full");
+}
+
+static void
+hbk_tab_del(struct hbk_tab *t, uint64_t h, uint64_t i, unsigned s)
+{
+	uint64_t j;
+
+	assert(t->b[i].oh[s] != NULL);
+	t->b[i].fp[s] = 0;
+	t->b[i].oh[s] = NULL;
+	assert(t->n > 0);
+	t->n--;
+	for (j = h & t->mask; j != i; j = (j + 1) & t->mask) {
+		assert(t->b[j].overflow > 0);
+		t->b[j].overflow--;
+	}
+}
+
+/*--------------------------------------------------------------------
+ * Incremental resizing
+ */
+
+static void
+hbk_migrate(struct hbk_part *hp, uint64_t nbucket)
+{
+	struct hbk_bucket *b;
+	struct objhead *oh;
+	uint64_t h;
+	unsigned s;
+
+	Lck_AssertHeld(&hp->mtx);
+	for (; hp->old.b != NULL && nbucket > 0; nbucket--) {
+		b = &hp->old.b[hp->mig];
+		for (s = 0; s < HBK_SLOTS; s++) {
+			oh = b->oh[s];
+			if (oh == NULL)
+				continue;
+			h = hbk_hash(oh->digest);
+			hbk_tab_put(&hp->cur, h, b->fp[s], oh);
+			hbk_tab_del(&hp->old, h, hp->mig, s);
+		}
+		if (++hp->mig > hp->old.mask) {
+			AZ(hp->old.n);
+			free(hp->old.b);
+			memset(&hp->old, 0, sizeof hp->old);
+			hp->mig = 0;
+		}
+	}
+}
+
+static int
+hbk_grow(struct hbk_part *hp)
+{
+
+	Lck_AssertHeld(&hp->mtx);
+	if (hp->cur.n + hp->old.n < (hp->cur.mask + 1) * HBK_SLOTS * 3 / 4)
+		return (0);
+	/* Still moving from the last resize, finish that first */
+	hbk_migrate(hp, hp->old.mask + 1);
+	AZ(hp->old.b);
+	hp->old = hp->cur;
+	hp->mig = 0;
+	hbk_tab_alloc(&hp->cur, (hp->old.mask + 1) * 2);
+	hp->nresize++;
+	return (1);
+}
+
+/*--------------------------------------------------------------------
+ * The ->init method allows the management process to pass arguments
+ */
+
+static void __match_proto__(hash_init_f)
+hbk_init(int ac, char * const *av)
+{
+	int i;
+	unsigned long u;
+
+	if (ac == 0)
+		return;
+	if (ac > 1)
+		ARGV_ERR("(-hbucket) too many arguments\n");
+	i = sscanf(av[0], "%lu", &u);
+	if (i <= 0 || u == 0)
+		ARGV_ERR("(-hbucket) need a number of objects\n");
+	/* Round up to a power of two buckets per partition */
+	u = (u + HBK_SLOTS * HBK_NPART - 1) / (HBK_SLOTS * HBK_NPART);
+	for (hbk_nbucket = 1; hbk_nbucket < u; hbk_nbucket <<= 1)
+		continue;
+	fprintf(stderr, "Bucket hash: %ju buckets of %d objects\n",
+	    (uintmax_t)hbk_nbucket * HBK_NPART, HBK_SLOTS);
+}
+
+/*--------------------------------------------------------------------*/
+
+static void
+hbk_stats(struct cli *cli, const char * const *av, void *priv)
+{
+	struct hbk_part *hp;
+	unsigned u;
+
+	(void)priv;
+	(void)av;
+	VCLI_Out(cli, "%4s %10s %10s %10s %10s %7s\n",
+	    "part", "objheads", "buckets", "old", "migrated", "resizes");
+	for (u = 0; u < HBK_NPART; u++) {
+		hp = &hbk_part[u];
+		Lck_Lock(&hp->mtx);
+		VCLI_Out(cli, "%4u %10ju %10ju %10ju %10ju %7u\n", u,
+		    (uintmax_t)(hp->cur.n + hp->old.n),
+		    (uintmax_t)hp->cur.mask + 1,
+		    (uintmax_t)(hp->old.b == NULL ? 0 : hp->old.mask + 1),
+		    (uintmax_t)hp->mig, hp->nresize);
+		Lck_Unlock(&hp->mtx);
+	}
+}
+
+static struct cli_proto hbk_cmds[] = {
+	{ "hbk.stats", "hbk.stats",
+		"\tShow size and resizing of the bucket hash partitions\n",
+		0, 0, "d", hbk_stats },
+	{ NULL }
+};
+
+/*--------------------------------------------------------------------
+ * The ->start method is called during cache process start and allows
+ * initialization to happen before the first lookup.
+ */
+
+static void __match_proto__(hash_start_f)
+hbk_start(void)
+{
+	unsigned u;
+
+	assert(sizeof(struct hbk_bucket) <= 64);
+	for (u = 0; u < HBK_NPART; u++) {
+		hbk_part[u].magic = HBK_PART_MAGIC;
+		Lck_New(&hbk_part[u].mtx, lck_hbk);
+		hbk_tab_alloc(&hbk_part[u].cur, hbk_nbucket);
+	}
+	CLI_AddFuncs(hbk_cmds);
+}
+
+/*--------------------------------------------------------------------
+ * Lookup and possibly insert element, see hash_classic.c
+ */
+
+static struct objhead * __match_proto__(hash_lookup_f)
+hbk_lookup(struct worker *wrk, const void *digest, struct objhead **noh)
+{
+	struct hbk_part *hp;
+	struct objhead *oh;
+	uint64_t h;
+	uint16_t fp;
+
+	CHECK_OBJ_NOTNULL(wrk, WORKER_MAGIC);
+	AN(digest);
+	if (noh != NULL)
+		CHECK_OBJ_NOTNULL(*noh, OBJHEAD_MAGIC);
+
+	h = hbk_hash(digest);
+	fp = hbk_fp(digest);
+	hp = hbk_getpart(h);
+
+	Lck_Lock(&hp->mtx);
+	hbk_migrate(hp, HBK_MIGRATE);
+	oh = hbk_tab_find(&hp->cur, h, fp, digest, NULL, NULL);
+	if (oh == NULL)
+		oh = hbk_tab_find(&hp->old, h, fp, digest, NULL, NULL);
+	if (oh != NULL) {
+		oh->refcnt++;
+		Lck_Unlock(&hp->mtx);
+		Lck_Lock(&oh->mtx);
+		return (oh);
+	}
+
+	if (noh == NULL) {
+		Lck_Unlock(&hp->mtx);
+		return (NULL);
+	}
+
+	if (hbk_grow(hp))
+		wrk->stats.hbk_resize++;
+	oh = *noh;
+	*noh = NULL;
+	memcpy(oh->digest, digest, sizeof oh->digest);
+	hbk_tab_put(&hp->cur, h, fp, oh);
+
+	Lck_Unlock(&hp->mtx);
+	Lck_Lock(&oh->mtx);
+	return (oh);
+}
+
+/*--------------------------------------------------------------------
+ * Dereference and if no references are left, free.
+ */
+
+static int __match_proto__(hash_deref_f)
+hbk_deref(struct objhead *oh)
+{
+	struct hbk_part *hp;
+	uint64_t h, i;
+	unsigned s;
+	uint16_t fp;
+	int ret;
+
+	CHECK_OBJ_NOTNULL(oh, OBJHEAD_MAGIC);
+	h = hbk_hash(oh->digest);
+	fp = hbk_fp(oh->digest);
+	hp = hbk_getpart(h);
+	Lck_Lock(&hp->mtx);
+	assert(oh->refcnt > 0);
+	if (--oh->refcnt == 0) {
+		if (hbk_tab_find(&hp->cur, h, fp, oh->digest, &i, &s) == oh)
+			hbk_tab_del(&hp->cur, h, i, s);
+		else if (hbk_tab_find(&hp->old, h, fp, oh->digest, &i, &s)
+		    == oh)
+			hbk_tab_del(&hp->old, h, i, s);
+		else
+			WRONG("hbk objhead not found");
+		ret = 0;
+	} else
+		ret = 1;
+	hbk_migrate(hp, HBK_MIGRATE);
+	Lck_Unlock(&hp->mtx);
+	return (ret);
+}
+
+/*--------------------------------------------------------------------*/
+
+const struct hash_slinger hbk_slinger = {
+	.magic	=	SLINGER_MAGIC,
+	.name	=	"bucket",
+	.init	=	hbk_init,
+	.start	=	hbk_start,
+	.lookup =	hbk_lookup,
+	.deref	=	hbk_deref,
+};
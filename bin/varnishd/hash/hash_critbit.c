@@ -32,6 +32,7 @@
 
 #include "config.h"
 
+#include <stdio.h>
 #include <stdlib.h>
 
 #include "cache/cache.h"
@@ -41,8 +42,6 @@
 #include "vmb.h"
 #include "vtim.h"
 
-static struct lock hcb_mtx;
-
 /*---------------------------------------------------------------------
  * Table for finding out how many bits two bytes have in common,
  * counting from the MSB towards the LSB.
@@ -104,12 +103,42 @@ struct hcb_root {
 	volatile uintptr_t	origo;
 };
 
-static struct hcb_root	hcb_root;
+/*---------------------------------------------------------------------
+ * The tree is split into 2^hcb_bits shards on the first bits of the
+ * digest, each with its own root, lock and lists for the cleaner.
+ */
+
+struct hcb_shard {
+	unsigned			magic;
+#define HCB_SHARD_MAGIC			0x3a0c5f17
+	struct lock			mtx;
+	struct hcb_root			root;
+	unsigned			nnode;
+	uint64_t			nlock;
+	VSTAILQ_HEAD(, hcb_y)		cool_y;
+	VSTAILQ_HEAD(, hcb_y)		dead_y;
+	VTAILQ_HEAD(, objhead)		cool_h;
+	VTAILQ_HEAD(, objhead)		dead_h;
+};
+
+#define HCB_MAX_BITS		8
 
-static VSTAILQ_HEAD(, hcb_y)	cool_y = VSTAILQ_HEAD_INITIALIZER(cool_y);
-static VSTAILQ_HEAD(, hcb_y)	dead_y = VSTAILQ_HEAD_INITIALIZER(dead_y);
-static VTAILQ_HEAD(, objhead)	cool_h = VTAILQ_HEAD_INITIALIZER(cool_h);
-static VTAILQ_HEAD(, objhead)	dead_h = VTAILQ_HEAD_INITIALIZER(dead_h);
+static unsigned			hcb_nbits = 4;
+static unsigned			hcb_nshard;
+static struct hcb_shard		*hcb_shards;
+
+static struct hcb_shard *
+hcb_shard(const uint8_t *digest)
+{
+	struct hcb_shard *sh;
+
+	if (hcb_nbits == 0)
+		sh = &hcb_shards[0];
+	else
+		sh = &hcb_shards[digest[0] >> (8 - hcb_nbits)];
+	CHECK_OBJ_NOTNULL(sh, HCB_SHARD_MAGIC);
+	return (sh);
+}
 
 /*---------------------------------------------------------------------
  * Pointer accessor functions
@@ -274,12 +303,17 @@ hcb_insert(struct worker *wrk, struct hcb_root *root, const uint8_t *digest,
 /*--------------------------------------------------------------------*/
 
 static void
-hcb_delete(struct hcb_root *r, struct objhead *oh)
+hcb_delete(struct hcb_shard *sh, struct objhead *oh)
 {
+	struct hcb_root *r;
 	struct hcb_y *y;
 	volatile uintptr_t *p;
 	unsigned s;
 
+	Lck_AssertHeld(&sh->mtx);
+	assert(sh->nnode > 0);
+	sh->nnode--;
+	r = &sh->root;
 	if (r->origo == hcb_r_node(oh)) {
 		r->origo = 0;
 		return;
@@ -296,7 +330,7 @@ hcb_delete(struct hcb_root *r, struct objhead *oh)
 		assert(s < 2);
 		if (y->leaf[s] == hcb_r_node(oh)) {
 			*p = y->leaf[1 - s];
-			VSTAILQ_INSERT_TAIL(&cool_y, y, list);
+			VSTAILQ_INSERT_TAIL(&sh->cool_y, y, list);
 			return;
 		}
 		p = &y->leaf[s];
@@ -334,16 +368,77 @@ dumptree(struct cli *cli, uintptr_t p, int indent)
 static void
 hcb_dump(struct cli *cli, const char * const *av, void *priv)
 {
+	unsigned u;
 
 	(void)priv;
 	(void)av;
 	VCLI_Out(cli, "HCB dump:\n");
-	dumptree(cli, hcb_root.origo, 0);
+	for (u = 0; u < hcb_nshard; u++) {
+		VCLI_Out(cli, "Shard %u:\n", u);
+		Lck_Lock(&hcb_shards[u].mtx);
+		dumptree(cli, hcb_shards[u].root.origo, 0);
+		Lck_Unlock(&hcb_shards[u].mtx);
+	}
 	VCLI_Out(cli, "Coollist:\n");
 }
 
+/*--------------------------------------------------------------------
+ * Sum up the depth of all nodes and find the deepest one
+ */
+
+static void
+hcb_depth(uintptr_t p, unsigned d, uint64_t *sum, unsigned *max)
+{
+	const struct hcb_y *y;
+
+	if (p == 0)
+		return;
+	if (hcb_is_node(p)) {
+		*sum += d;
+		if (d > *max)
+			*max = d;
+		return;
+	}
+	y = hcb_l_y(p);
+	hcb_depth(y->leaf[0], d + 1, sum, max);
+	hcb_depth(y->leaf[1], d + 1, sum, max);
+}
+
+static void
+hcb_stats(struct cli *cli, const char * const *av, void *priv)
+{
+	struct hcb_shard *sh;
+	unsigned u, n, max, tmax = 0;
+	uint64_t sum, tsum = 0, tn = 0;
+
+	(void)priv;
+	(void)av;
+	VCLI_Out(cli, "%5s %10s %9s %9s %12s\n",
+	    "shard", "objheads", "max_depth", "avg_depth", "locked");
+	for (u = 0; u < hcb_nshard; u++) {
+		sh = &hcb_shards[u];
+		sum = 0;
+		max = 0;
+		Lck_Lock(&sh->mtx);
+		n = sh->nnode;
+		hcb_depth(sh->root.origo, 0, &sum, &max);
+		VCLI_Out(cli, "%5u %10u %9u %9.1f %12ju\n", u, n, max,
+		    n > 0 ? (double)sum / n : 0., (uintmax_t)sh->nlock);
+		Lck_Unlock(&sh->mtx);
+		tn += n;
+		tsum += sum;
+		if (max > tmax)
+			tmax = max;
+	}
+	VCLI_Out(cli, "%5s %10ju %9u %9.1f\n", "all", (uintmax_t)tn, tmax,
+	    tn > 0 ? (double)tsum / tn : 0.);
+}
+
 static struct cli_proto hcb_cmds[] = {
 	{ "hcb.dump", "hcb.dump", "dump HCB tree\n", 0, 0, "d", hcb_dump },
+	{ "hcb.stats", "hcb.stats",
+		"\tShow size and depth of the HCB tree shards\n",
+		0, 0, "d", hcb_stats },
 	{ NULL }
 };
 
@@ -352,48 +447,86 @@ static struct cli_proto hcb_cmds[] = {
 static void * __match_proto__(bgthread_t)
 hcb_cleaner(struct worker *wrk, void *priv)
 {
+	struct hcb_shard *sh;
 	struct hcb_y *y, *y2;
 	struct objhead *oh, *oh2;
+	unsigned u;
 
 	(void)priv;
 	while (1) {
-		VSTAILQ_FOREACH_SAFE(y, &dead_y, list, y2) {
-			VSTAILQ_REMOVE_HEAD(&dead_y, list);
-			FREE_OBJ(y);
-		}
-		VTAILQ_FOREACH_SAFE(oh, &dead_h, hoh_list, oh2) {
-			VTAILQ_REMOVE(&dead_h, oh, hoh_list);
-			HSH_DeleteObjHead(&wrk->stats, oh);
+		for (u = 0; u < hcb_nshard; u++) {
+			sh = &hcb_shards[u];
+			VSTAILQ_FOREACH_SAFE(y, &sh->dead_y, list, y2) {
+				VSTAILQ_REMOVE_HEAD(&sh->dead_y, list);
+				FREE_OBJ(y);
+			}
+			VTAILQ_FOREACH_SAFE(oh, &sh->dead_h, hoh_list, oh2) {
+				VTAILQ_REMOVE(&sh->dead_h, oh, hoh_list);
+				HSH_DeleteObjHead(&wrk->stats, oh);
+			}
+			Lck_Lock(&sh->mtx);
+			VSTAILQ_CONCAT(&sh->dead_y, &sh->cool_y);
+			VTAILQ_CONCAT(&sh->dead_h, &sh->cool_h, hoh_list);
+			Lck_Unlock(&sh->mtx);
 		}
-		Lck_Lock(&hcb_mtx);
-		VSTAILQ_CONCAT(&dead_y, &cool_y);
-		VTAILQ_CONCAT(&dead_h, &cool_h, hoh_list);
-		Lck_Unlock(&hcb_mtx);
 		WRK_SumStat(wrk);
 		VTIM_sleep(cache_param->critbit_cooloff);
 	}
 	NEEDLESS_RETURN(NULL);
 }
 
+/*--------------------------------------------------------------------
+ * The ->init method allows the management process to pass arguments
+ */
+
+static void __match_proto__(hash_init_f)
+hcb_init(int ac, char * const *av)
+{
+	int i;
+	unsigned u;
+
+	if (ac == 0)
+		return;
+	if (ac > 1)
+		ARGV_ERR("(-hcritbit) too many arguments\n");
+	i = sscanf(av[0], "%u", &u);
+	if (i <= 0 || u > HCB_MAX_BITS)
+		ARGV_ERR("(-hcritbit) shard bits must be 0...%d\n",
+		    HCB_MAX_BITS);
+	hcb_nbits = u;
+	fprintf(stderr, "Critbit hash: %u shards\n", 1U << hcb_nbits);
+}
+
 /*--------------------------------------------------------------------*/
 
 static void __match_proto__(hash_start_f)
 hcb_start(void)
 {
-	struct objhead *oh = NULL;
+	struct hcb_shard *sh;
 	pthread_t tp;
+	unsigned u;
 
-	(void)oh;
 	CLI_AddFuncs(hcb_cmds);
-	Lck_New(&hcb_mtx, lck_hcb);
-	WRK_BgThread(&tp, "hcb-cleaner", hcb_cleaner, NULL);
-	memset(&hcb_root, 0, sizeof hcb_root);
+	hcb_nshard = 1U << hcb_nbits;
+	hcb_shards = calloc(sizeof *hcb_shards, hcb_nshard);
+	XXXAN(hcb_shards);
+	for (u = 0; u < hcb_nshard; u++) {
+		sh = &hcb_shards[u];
+		sh->magic = HCB_SHARD_MAGIC;
+		Lck_New(&sh->mtx, lck_hcb);
+		VSTAILQ_INIT(&sh->cool_y);
+		VSTAILQ_INIT(&sh->dead_y);
+		VTAILQ_INIT(&sh->cool_h);
+		VTAILQ_INIT(&sh->dead_h);
+	}
 	hcb_build_bittbl();
+	WRK_BgThread(&tp, "hcb-cleaner", hcb_cleaner, NULL);
 }
 
 static int __match_proto__(hash_deref_f)
 hcb_deref(struct objhead *oh)
 {
+	struct hcb_shard *sh;
 	int r;
 
 	r = 1;
@@ -402,10 +535,11 @@ hcb_deref(struct objhead *oh)
 	assert(oh->refcnt > 0);
 	oh->refcnt--;
 	if (oh->refcnt == 0) {
-		Lck_Lock(&hcb_mtx);
-		hcb_delete(&hcb_root, oh);
-		VTAILQ_INSERT_TAIL(&cool_h, oh, hoh_list);
-		Lck_Unlock(&hcb_mtx);
+		sh = hcb_shard(oh->digest);
+		Lck_Lock(&sh->mtx);
+		hcb_delete(sh, oh);
+		VTAILQ_INSERT_TAIL(&sh->cool_h, oh, hoh_list);
+		Lck_Unlock(&sh->mtx);
 		assert(VTAILQ_EMPTY(&oh->objcs));
 		AZ(oh->waitinglist);
 	}
@@ -419,12 +553,14 @@ hcb_deref(struct objhead *oh)
 static struct objhead * __match_proto__(hash_lookup_f)
 hcb_lookup(struct worker *wrk, const void *digest, struct objhead **noh)
 {
+	struct hcb_shard *sh;
 	struct objhead *oh;
 	struct hcb_y *y;
 	unsigned u;
 
 	CHECK_OBJ_NOTNULL(wrk, WORKER_MAGIC);
 	AN(digest);
+	sh = hcb_shard(digest);
 	if (noh != NULL) {
 		CHECK_OBJ_NOTNULL(*noh, OBJHEAD_MAGIC);
 		assert((*noh)->refcnt == 1);
@@ -433,7 +569,7 @@ hcb_lookup(struct worker *wrk, const void *digest, struct objhead **noh)
 	/* First try in read-only mode without holding a lock */
 
 	wrk->stats.hcb_nolock++;
-	oh = hcb_insert(wrk, &hcb_root, digest, NULL);
+	oh = hcb_insert(wrk, &sh->root, digest, NULL);
 	if (oh != NULL) {
 		Lck_Lock(&oh->mtx);
 		/*
@@ -451,10 +587,13 @@ hcb_lookup(struct worker *wrk, const void *digest, struct objhead **noh)
 	while (1) {
 		/* No luck, try with lock held, so we can modify tree */
 		CAST_OBJ_NOTNULL(y, wrk->nhashpriv, HCB_Y_MAGIC);
-		Lck_Lock(&hcb_mtx);
-		VSC_C_main->hcb_lock++;
-		oh = hcb_insert(wrk, &hcb_root, digest, noh);
-		Lck_Unlock(&hcb_mtx);
+		Lck_Lock(&sh->mtx);
+		sh->nlock++;
+		wrk->stats.hcb_lock++;
+		oh = hcb_insert(wrk, &sh->root, digest, noh);
+		if (noh != NULL && *noh == NULL)
+			sh->nnode++;
+		Lck_Unlock(&sh->mtx);
 
 		if (oh == NULL)
 			return (NULL);
@@ -464,7 +603,7 @@ hcb_lookup(struct worker *wrk, const void *digest, struct objhead **noh)
 		CHECK_OBJ_NOTNULL(oh, OBJHEAD_MAGIC);
 		if (noh != NULL && *noh == NULL) {
 			assert(oh->refcnt > 0);
-			VSC_C_main->hcb_insert++;
+			wrk->stats.hcb_insert++;
 			return (oh);
 		}
 		/*
@@ -495,6 +634,7 @@ hcb_prep(struct worker *wrk)
 const struct hash_slinger hcb_slinger = {
 	.magic  =	SLINGER_MAGIC,
 	.name   =	"critbit",
+	.init   =	hcb_init,
 	.start  =	hcb_start,
 	.lookup =	hcb_lookup,
 	.prep =		hcb_prep,
@@ -46,6 +46,7 @@ static const struct choice hsh_choice[] = {
 	{ "simple",		&hsl_slinger },
 	{ "simple_list",	&hsl_slinger },	/* backwards compat */
 	{ "critbit",		&hcb_slinger },
+	{ "bucket",		&hbk_slinger },
 	{ NULL,			NULL }
 };
 
@@ -92,6 +92,7 @@ struct objhead {
 	VTAILQ_HEAD(,objcore)	objcs;
 	uint8_t			digest[DIGEST_LEN];
 	struct waitinglist	*waitinglist;
+	uint8_t			*vary_spec;	/* Vary index headers */
 
 	/*----------------------------------------------------
 	 * The fields below are for the sole private use of
@@ -107,8 +108,8 @@ struct objhead {
 #define hoh_head _u.n.u_n_hoh_head
 };
 
-void HSH_Unbusy(struct dstat *, struct objcore *);
-void HSH_Complete(struct objcore *oc);
+void HSH_Unbusy(struct worker *, struct objcore *);
+void HSH_Complete(struct worker *, struct objcore *oc);
 void HSH_DeleteObjHead(struct dstat *, struct objhead *oh);
 int HSH_DerefObjHead(struct dstat *, struct objhead **poh);
 int HSH_Deref(struct dstat *, struct objcore *oc, struct object **o);
@@ -117,3 +118,4 @@ int HSH_Deref(struct dstat *, struct objcore *oc, struct object **o);
 extern const struct hash_slinger hsl_slinger;
 extern const struct hash_slinger hcl_slinger;
 extern const struct hash_slinger hcb_slinger;
+extern const struct hash_slinger hbk_slinger;
@@ -32,6 +32,7 @@
 #include "config.h"
 
 #include <sys/types.h>
+#include <sys/socket.h>
 #include <sys/wait.h>
 
 #include <fcntl.h>
@@ -223,22 +224,64 @@ mgt_child_inherit(int fd, const char *what)
  * (The child is priv-sep'ed, so it can't do it.)
  */
 
+/*
+ * With thread_pool_numa, every pool gets its own copy of each socket,
+ * bound with SO_REUSEPORT.  The copies share name and address with
+ * the original and live only until MGT_close_sockets().
+ */
+
+static void
+mgt_pool_sockets(struct listen_sock *ls, unsigned npool)
+{
+	struct listen_sock *ls2;
+	unsigned u;
+
+	for (u = 1; u < npool; u++) {
+		ALLOC_OBJ(ls2, LISTEN_SOCK_MAGIC);
+		XXXAN(ls2);
+		ls2->name = ls->name;
+		ls2->addr = ls->addr;
+		ls2->pool = u;
+		ls2->sock = VSS_bind_reuseport(ls->addr);
+		if (ls2->sock < 0) {
+			REPORT(LOG_ERR, "Could not open pool %u socket %s",
+			    u, ls->name);
+			FREE_OBJ(ls2);
+			continue;
+		}
+		mgt_child_inherit(ls2->sock, "sock");
+		VTAILQ_INSERT_AFTER(&heritage.socks, ls, ls2, list);
+	}
+}
+
 int
 MGT_open_sockets(void)
 {
 	struct listen_sock *ls;
 	int good = 0;
 
+	heritage.sock_pools = 1;
+#ifdef SO_REUSEPORT
+	if (mgt_param.wthread_numa)
+		heritage.sock_pools = mgt_param.wthread_pools;
+#endif
+
 	VTAILQ_FOREACH(ls, &heritage.socks, list) {
+		if (ls->pool != 0)
+			continue;
 		if (ls->sock >= 0) {
 			good++;
 			continue;
 		}
-		ls->sock = VSS_bind(ls->addr);
+		if (heritage.sock_pools > 1)
+			ls->sock = VSS_bind_reuseport(ls->addr);
+		else
+			ls->sock = VSS_bind(ls->addr);
 		if (ls->sock < 0)
 			continue;
 
 		mgt_child_inherit(ls->sock, "sock");
+		mgt_pool_sockets(ls, heritage.sock_pools);
 
 		good++;
 	}
@@ -252,13 +295,17 @@ MGT_open_sockets(void)
 void
 MGT_close_sockets(void)
 {
-	struct listen_sock *ls;
+	struct listen_sock *ls, *ls2;
 
-	VTAILQ_FOREACH(ls, &heritage.socks, list) {
-		if (ls->sock < 0)
-			continue;
-		mgt_child_inherit(ls->sock, NULL);
-		closex(&ls->sock);
+	VTAILQ_FOREACH_SAFE(ls, &heritage.socks, list, ls2) {
+		if (ls->sock >= 0) {
+			mgt_child_inherit(ls->sock, NULL);
+			closex(&ls->sock);
+		}
+		if (ls->pool != 0) {
+			VTAILQ_REMOVE(&heritage.socks, ls, list);
+			FREE_OBJ(ls);
+		}
 	}
 }
 
@@ -184,6 +184,22 @@ const struct parspec mgt_parspec[] = {
 		"for it to do.\n",
 		0,
 		"1", "seconds" },
+	{ "expiry_shards", tweak_uint, &mgt_param.expiry_shards, 1, 64,
+		"Number of shards the object timers are split over.\n"
+		"Each shard has its own lock, binary heap and expiry thread, "
+		"objects are spread over the shards by their address.\n"
+		"Increase this if the exp lock shows contention, roughly "
+		"one shard per four CPUs is a good starting point.",
+		EXPERIMENTAL | MUST_RESTART,
+		"1", "shards" },
+	{ "expiry_batch", tweak_uint, &mgt_param.expiry_batch, 1, 65535,
+		"Maximum number of expired objects the expiry thread takes "
+		"off the timer heap per lock operation.\n"
+		"Larger batches let the expiry thread keep up when many "
+		"objects expire at the same time, at the cost of holding "
+		"the expiry lock for longer.",
+		EXPERIMENTAL,
+		"1", "objects" },
 	{ "pipe_timeout", tweak_timeout, &mgt_param.pipe_timeout, 0, 0,
 		"Idle timeout for PIPE sessions. "
 		"If nothing have been received in either direction for "
@@ -258,6 +274,17 @@ const struct parspec mgt_parspec[] = {
 		"fragmentation.\n",
 		EXPERIMENTAL,
 		"256m", "bytes" },
+	{ "delivery_prefetch",
+		tweak_bytes,
+		    &mgt_param.delivery_prefetch, 0, UINT_MAX,
+		"How far ahead of the client we ask the stevedore to read "
+		"in the body of an object we deliver.  This lets the file "
+		"stevedore start the disk reads before the worker thread "
+		"needs the data, instead of taking the page faults one at "
+		"a time while writing to the client.\n"
+		"Zero disables prefetching.",
+		EXPERIMENTAL,
+		"1m", "bytes" },
 	{ "accept_filter", tweak_bool, &mgt_param.accept_filter, 0, 0,
 		"Enable kernel accept-filters, if supported by the kernel.",
 		MUST_RESTART,
@@ -286,7 +313,7 @@ const struct parspec mgt_parspec[] = {
 		" this limit, the reponse code will be 201 instead of"
 		" 200 and the last line will indicate the truncation.",
 		0,
-		"48k", "bytes" },
+		"64k", "bytes" },
 	{ "cli_timeout", tweak_timeout, &mgt_param.cli_timeout, 0, 0,
 		"Timeout for the childs replies to CLI requests from "
 		"the mgt_param.",
@@ -299,13 +326,29 @@ const struct parspec mgt_parspec[] = {
 		MUST_RESTART,
 		"3", "seconds" },
 	{ "lru_interval", tweak_timeout, &mgt_param.lru_timeout, 0, 0,
-		"Grace period before object moves on LRU list.\n"
-		"Objects are only moved to the front of the LRU "
-		"list if they have not been moved there already inside "
-		"this timeout period.  This reduces the amount of lock "
-		"operations necessary for LRU list access.",
+		"Grace period before a hit marks an object as referenced "
+		"again.\n"
+		"Objects are only marked as referenced for the LRU "
+		"list if they have not been marked already inside "
+		"this timeout period.  This reduces the amount of memory "
+		"writes to frequently used objects.\n"
+		"Objects are not moved on a hit.  When space is needed, "
+		"referenced objects found on the LRU get a second chance: "
+		"with the lru=classic policy of the stevedore they are "
+		"moved to the tail, with lru=slru or lru=tinylfu they are "
+		"promoted to the protected segment.",
 		EXPERIMENTAL,
 		"2", "seconds" },
+	{ "lru_protected", tweak_uint, &mgt_param.lru_protected, 0, 100,
+		"Percentage of the objects on a stevedore with the slru "
+		"or tinylfu eviction policy, which may be held in the "
+		"protected segment of the LRU.\n"
+		"Objects are promoted to the protected segment when they "
+		"are found referenced by the LRU, and are only evicted "
+		"from there when the probationary segment holds nothing "
+		"which can be evicted.",
+		EXPERIMENTAL,
+		"80", "%" },
 	{ "cc_command", tweak_string, &mgt_cc_cmd, 0, 0,
 		"Command used for compiling the C source code to a "
 		"dlopen(3) loadable object.  Any occurrence of %s in "
@@ -434,6 +477,13 @@ const struct parspec mgt_parspec[] = {
 		"Select the waiter kernel interface.\n",
 		WIZARD | MUST_RESTART,
 		WAITER_DEFAULT, NULL },
+	{ "waiter_threads", tweak_uint, &mgt_param.waiter_threads, 1, 64,
+		"Number of event engines for the epoll waiter, each "
+		"with its own epoll instance and thread.\n"
+		"Idle sessions are spread over them by file descriptor.\n"
+		"Other waiters ignore this parameter.",
+		EXPERIMENTAL | MUST_RESTART,
+		"1", "threads" },
 	{ "ban_dups", tweak_bool, &mgt_param.ban_dups, 0, 0,
 		"Detect and eliminate duplicate bans.\n",
 		0,
@@ -183,6 +183,23 @@ const struct parspec WRK_parspec[] = {
 		"destroyed and later recreated.\n",
 		EXPERIMENTAL,
 		"0.2", "seconds" },
+	{ "thread_pool_numa",
+		tweak_bool, &mgt_param.wthread_numa, 0, 0,
+		"Bind thread pools to NUMA nodes.\n"
+		"\n"
+		"Pools are assigned round-robin to the NUMA nodes of the "
+		"machine, and their worker threads only run on the CPUs of "
+		"that node, so their stacks and workspaces are allocated "
+		"from node-local memory.\n"
+		"Each pool also gets its own SO_REUSEPORT copy of the "
+		"listen sockets, so the kernel spreads connections over "
+		"the pools and a connection stays on one node.\n"
+		"\n"
+		"Pools added on the fly share the listen sockets of the "
+		"pools created at startup.\n"
+		"Ignored on platforms without thread CPU affinity.",
+		EXPERIMENTAL | MUST_RESTART,
+		"off", "bool" },
 	{ "thread_stats_rate",
 		tweak_uint, &mgt_param.wthread_stats_rate, 0, UINT_MAX,
 		"Worker threads accumulate statistics, and dump these into "
@@ -202,6 +219,21 @@ const struct parspec WRK_parspec[] = {
 		"be dropped instead of queued.\n",
 		EXPERIMENTAL,
 		"20", "" },
+	{ "thread_queue_target",
+		tweak_timeout_double, &mgt_param.wthread_queue_target,
+		0, UINT_MAX,
+		"Target queue wait for the adaptive thread herder.\n"
+		"\n"
+		"When non-zero, the herder of each pool measures the task "
+		"arrival rate and how long queued tasks wait for a thread, "
+		"and creates threads in batches, without "
+		"thread_pool_add_delay between them, to drain the queue and "
+		"keep the wait below this target.\n"
+		"\n"
+		"Zero selects the classic herder, which creates one thread "
+		"at a time when the pool runs dry.",
+		EXPERIMENTAL,
+		"0", "seconds" },
 	{ "rush_exponent", tweak_uint, &mgt_param.rush_exponent, 2, UINT_MAX,
 		"How many parked request we start for each completed "
 		"request on the object.\n"
@@ -210,6 +242,33 @@ const struct parspec WRK_parspec[] = {
 		"number of worker threads.",
 		EXPERIMENTAL,
 		"3", "requests per request" },
+	{ "rush_coalesce", tweak_bool, &mgt_param.rush_coalesce, 0, 0,
+		"Hand a finished object directly to all the requests "
+		"waiting for it.\n"
+		"When the fetch of a busy object completes, every request "
+		"on its waiting list which can use the object gets a "
+		"reference to it, and they are rescheduled in one batch "
+		"without repeating their lookup.  Idle threads are used "
+		"as available, the rest of the batch is put at the front "
+		"of the thread queue, and the thread which runs the batch "
+		"serves the last request itself.  As with rushed "
+		"requests, those which find the queue at "
+		"thread_queue_limit are dropped.\n"
+		"Requests which cannot use the object, for instance "
+		"because it has a Vary header, are woken as per "
+		"rush_exponent.",
+		EXPERIMENTAL,
+		"off", "bool" },
+	{ "rush_stream", tweak_bool, &mgt_param.rush_stream, 0, 0,
+		"Deliver objects while their body is being fetched.\n"
+		"Once the headers are in, the request which started the "
+		"fetch, later lookups and the requests on the waiting list "
+		"send the body as it arrives, if beresp.do_stream allows "
+		"and it is not ESI processed.  Requests waiting for a "
+		"hit-for-pass object are let go at the same time.\n"
+		"When off, all of them wait for the fetch to complete.",
+		EXPERIMENTAL,
+		"off", "bool" },
 	{ "thread_pool_stack",
 		tweak_stack_size, &mgt_param.wthread_stacksize, 0, UINT_MAX,
 		"Worker thread stack size.\n"
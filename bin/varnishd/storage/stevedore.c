@@ -110,6 +110,7 @@ LRU_Alloc(void)
 	ALLOC_OBJ(l, LRU_MAGIC);
 	AN(l);
 	VTAILQ_INIT(&l->lru_head);
+	VTAILQ_INIT(&l->lru_prot);
 	Lck_New(&l->mtx, lck_lru);
 	return (l);
 }
@@ -119,6 +120,9 @@ LRU_Free(struct lru *lru)
 {
 	CHECK_OBJ_NOTNULL(lru, LRU_MAGIC);
 	Lck_Delete(&lru->mtx);
+	free(lru->sketch);
+	if (lru->vsc != NULL)
+		VSM_Free(lru->vsc);
 	FREE_OBJ(lru);
 }
 
@@ -276,7 +280,7 @@ STV_MkObject(struct stevedore *stv, struct busyobj *bo,
 	l = PRNDDN(ltot - (sizeof *o + soc->lhttp));
 	assert(l >= soc->wsl);
 
-	o->http = HTTP_create(o + 1, soc->nhttp);
+	o->http = HTTP_create(o + 1, soc->nhttp, 0);
 	WS_Init(o->ws_o, "obj", (char *)(o + 1) + soc->lhttp, soc->wsl);
 	WS_Assert(o->ws_o);
 	assert(o->ws_o->e <= (char*)ptr + ltot);
@@ -346,7 +350,7 @@ STV_NewObject(struct busyobj *bo, const char *hint,
 	assert(wsl > 0);
 	wsl = PRNDUP(wsl);
 
-	lhttp = HTTP_estimate(nhttp);
+	lhttp = HTTP_estimate(nhttp, 0);
 	lhttp = PRNDUP(lhttp);
 
 	memset(&soc, 0, sizeof soc);
@@ -438,6 +442,21 @@ STV_free(struct storage *st)
 	st->stevedore->free(st);
 }
 
+/*--------------------------------------------------------------------
+ * Hint that a storage segment will be delivered soon.  Stevedores which
+ * may have to go to disk for it get a chance to start reading it in.
+ */
+
+void
+STV_Prefetch(const struct storage *st)
+{
+
+	CHECK_OBJ_NOTNULL(st, STORAGE_MAGIC);
+	AN(st->stevedore);
+	if (st->stevedore->prefetch != NULL)
+		st->stevedore->prefetch(st);
+}
+
 void
 STV_open(void)
 {
@@ -445,12 +464,14 @@ STV_open(void)
 
 	VTAILQ_FOREACH(stv, &stv_stevedores, list) {
 		stv->lru = LRU_Alloc();
+		EXP_LruPolicy(stv->lru, stv->lru_policy, stv->ident);
 		if (stv->open != NULL)
 			stv->open(stv);
 	}
 	stv = stv_transient;
 	if (stv->open != NULL) {
 		stv->lru = LRU_Alloc();
+		EXP_LruPolicy(stv->lru, stv->lru_policy, stv->ident);
 		stv->open(stv);
 	}
 	stv_next = VTAILQ_FIRST(&stv_stevedores);
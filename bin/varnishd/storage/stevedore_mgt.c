@@ -73,6 +73,25 @@ struct cli_proto cli_stv[] = {
 	    0, 0, "", stv_cli_list },
 	{ NULL}
 };
+/*--------------------------------------------------------------------
+ * Parse the generic "lru=policy" stevedore argument
+ */
+
+static void
+stv_lru_policy(struct stevedore *stv, const char *policy)
+{
+
+	if (!strcmp(policy, "classic"))
+		stv->lru_policy = LRU_CLASSIC;
+	else if (!strcmp(policy, "slru"))
+		stv->lru_policy = LRU_SLRU;
+	else if (!strcmp(policy, "tinylfu"))
+		stv->lru_policy = LRU_TINYLFU;
+	else
+		ARGV_ERR("(-s%s) unknown lru policy \"%s\" "
+		    "{classic, slru, tinylfu}\n", stv->name, policy);
+}
+
 /*--------------------------------------------------------------------
  * Parse a stevedore argument on the form:
  *	[ name '=' ] strategy [ ',' arg ] *
@@ -95,7 +114,7 @@ STV_Config(const char *spec)
 	const char *p, *q;
 	struct stevedore *stv;
 	const struct stevedore *stv2;
-	int ac, l;
+	int ac, l, i;
 	static unsigned seq = 0;
 
 	ASSERT_MGT();
@@ -152,6 +171,17 @@ STV_Config(const char *spec)
 		    stv->ident, stv->name);
 	}
 
+	/* Generic arguments are not for the stevedore to see */
+	for (i = 0; i < ac; ) {
+		if (strncmp(av[i], "lru=", 4)) {
+			i++;
+			continue;
+		}
+		stv_lru_policy(stv, av[i] + 4);
+		memmove(av + i, av + i + 1, (ac - i) * sizeof *av);
+		ac--;
+	}
+
 	if (stv->init != NULL)
 		stv->init(stv, ac, av);
 	else if (ac != 0)
@@ -44,6 +44,7 @@ typedef void storage_open_f(const struct stevedore *);
 typedef struct storage *storage_alloc_f(struct stevedore *, size_t size);
 typedef void storage_trim_f(struct storage *, size_t size, int move_ok);
 typedef void storage_free_f(struct storage *);
+typedef void storage_prefetch_f(const struct storage *);
 typedef struct object *storage_allocobj_f(struct stevedore *, struct busyobj *,
     unsigned ltot, const struct stv_objsecrets *);
 typedef void storage_close_f(const struct stevedore *);
@@ -72,6 +73,7 @@ struct stevedore {
 	storage_alloc_f		*alloc;		/* --//-- */
 	storage_trim_f		*trim;		/* --//-- */
 	storage_free_f		*free;		/* --//-- */
+	storage_prefetch_f	*prefetch;	/* --//-- */
 	storage_close_f		*close;		/* --//-- */
 	storage_allocobj_f	*allocobj;	/* --//-- */
 	storage_signal_close_f	*signal_close;	/* --//-- */
@@ -79,6 +81,7 @@ struct stevedore {
 	storage_banexport_f	*banexport;	/* --//-- */
 
 	struct lru		*lru;
+	enum lru_policy		lru_policy;
 
 #define VRTSTVVAR(nm, vtype, ctype, dval) storage_var_##ctype *var_##nm;
 #include "tbl/vrt_stv_var.h"
@@ -106,6 +109,17 @@ struct object *STV_MkObject(struct stevedore *stv, struct busyobj *bo,
 struct lru *LRU_Alloc(void);
 void LRU_Free(struct lru *lru);
 
+/*--------------------------------------------------------------------
+ * Add to a stevedore counter, atomically where we can.  Without 64 bit
+ * atomics the caller must hold the lock which protects the counters.
+ */
+
+#ifdef HAVE_SYNC_ATOMICS64
+#  define STV_ADD(p, n)		((void)__sync_fetch_and_add((p), (n)))
+#else
+#  define STV_ADD(p, n)		((void)(*(p) += (n)))
+#endif
+
 /*--------------------------------------------------------------------*/
 extern const struct stevedore sma_stevedore;
 extern const struct stevedore smf_stevedore;
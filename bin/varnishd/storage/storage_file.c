@@ -32,14 +32,25 @@
 #include "config.h"
 
 #include <sys/mman.h>
+#if defined(HAVE_SYS_VFS_H) && defined(__linux__)
+#  include <sys/vfs.h>
+#  ifndef HUGETLBFS_MAGIC
+#    define HUGETLBFS_MAGIC	0x958458f6
+#  endif
+#endif
 
+#include <fcntl.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "cache/cache.h"
 #include "storage/storage.h"
 
+#include "vcli.h"
+#include "vcli_priv.h"
 #include "vnum.h"
+#include "vtree.h"
 
 #ifndef MAP_NOCORE
 #define MAP_NOCORE 0 /* XXX Linux */
@@ -52,17 +63,20 @@
 #define MINPAGES		128
 
 /*
- * Number of buckets on free-list.
+ * Free ranges shorter than this many pages are counted as fragments.
  *
- * Last bucket is "larger than" so choose number so that the second
- * to last bucket matches the 128k CHUNKSIZE in cache_fetch.c when
- * using the a 4K minimal page size
+ * Choose the number so that the largest fragment matches the 128k
+ * CHUNKSIZE in cache_fetch.c when using the a 4K minimal page size
  */
-#define NBUCKET			(128 / 4 + 1)
+#define SMALLPAGES		(128 / 4 + 1)
+
+/* Number of power-of-two size classes in the fragmentation report */
+#define NHIST			24
 
 /*--------------------------------------------------------------------*/
 
 VTAILQ_HEAD(smfhead, smf);
+VRB_HEAD(smf_freetree, smf);
 
 struct smf {
 	unsigned		magic;
@@ -78,7 +92,8 @@ struct smf {
 
 	VTAILQ_ENTRY(smf)	order;
 	VTAILQ_ENTRY(smf)	status;
-	struct smfhead		*flist;
+	VRB_ENTRY(smf)		tree;
+	int			isfree;
 };
 
 struct smf_sc {
@@ -86,26 +101,70 @@ struct smf_sc {
 #define SMF_SC_MAGIC		0x52962ee7
 	struct lock		mtx;
 	struct VSC_C_smf	*stats;
+	const struct stevedore	*stevedore;
+	VTAILQ_ENTRY(smf_sc)	list;
 
 	const char		*filename;
 	int			fd;
 	unsigned		pagesize;
+	unsigned		hugepage;	/* Advise THP */
+	unsigned		hugetlbfs;	/* Always huge */
 	uintmax_t		filesize;
 	struct smfhead		order;
-	struct smfhead		free[NBUCKET];
+	struct smf_freetree	free;
 	struct smfhead		used;
 };
 
+/*
+ * Only used for the CLI report.  The list only changes during startup,
+ * when we are single-threaded.
+ */
+static VTAILQ_HEAD(,smf_sc)	smf_scs = VTAILQ_HEAD_INITIALIZER(smf_scs);
+
+/*--------------------------------------------------------------------
+ * The free ranges are kept in a tree sorted by size, then by offset,
+ * so that finding the smallest range large enough, lowest in the file,
+ * is a single descent.  Neighbours for coalescing are found through the
+ * order list.
+ */
+
+static inline int
+smf_free_cmp(const struct smf *a, const struct smf *b)
+{
+
+	if (a->size != b->size)
+		return (a->size < b->size ? -1 : 1);
+	if (a->offset != b->offset)
+		return (a->offset < b->offset ? -1 : 1);
+	return (0);
+}
+
+VRB_PROTOTYPE_STATIC(smf_freetree, smf, tree, smf_free_cmp)
+VRB_GENERATE_STATIC(smf_freetree, smf, tree, smf_free_cmp)
+
 /*--------------------------------------------------------------------*/
 
 static void
 smf_initfile(struct smf_sc *sc, const char *size)
 {
+#ifdef HUGETLBFS_MAGIC
+	struct statfs fsst;
+#endif
+
 	sc->filesize = STV_FileSize(sc->fd, size, &sc->pagesize, "-sfile");
 
 	AZ(ftruncate(sc->fd, (off_t)sc->filesize));
 
 	/* XXX: force block allocation here or in open ? */
+
+#ifdef HUGETLBFS_MAGIC
+	/*
+	 * A file on hugetlbfs is mapped with huge pages no matter what,
+	 * and its block size, and so our granularity, is the page size.
+	 */
+	if (!fstatfs(sc->fd, &fsst) && fsst.f_type == HUGETLBFS_MAGIC)
+		sc->hugetlbfs = 1;
+#endif
 }
 
 static const char default_size[] = "100M";
@@ -116,7 +175,6 @@ smf_init(struct stevedore *parent, int ac, char * const *av)
 {
 	const char *size, *fn, *r;
 	struct smf_sc *sc;
-	unsigned u;
 	uintmax_t page_size;
 
 	AZ(av[ac]);
@@ -125,7 +183,7 @@ smf_init(struct stevedore *parent, int ac, char * const *av)
 	size = default_size;
 	page_size = getpagesize();
 
-	if (ac > 3)
+	if (ac > 4)
 		ARGV_ERR("(-sfile) too many arguments\n");
 	if (ac > 0 && *av[0] != '\0')
 		fn = av[0];
@@ -143,9 +201,13 @@ smf_init(struct stevedore *parent, int ac, char * const *av)
 
 	ALLOC_OBJ(sc, SMF_SC_MAGIC);
 	XXXAN(sc);
+	if (ac > 3 && *av[3] != '\0') {
+		if (strcmp(av[3], "hugepage"))
+			ARGV_ERR("(-sfile) unknown argument \"%s\"\n", av[3]);
+		sc->hugepage = 1;
+	}
 	VTAILQ_INIT(&sc->order);
-	for (u = 0; u < NBUCKET; u++)
-		VTAILQ_INIT(&sc->free[u]);
+	VRB_INIT(&sc->free);
 	VTAILQ_INIT(&sc->used);
 	sc->pagesize = page_size;
 
@@ -158,86 +220,52 @@ smf_init(struct stevedore *parent, int ac, char * const *av)
 }
 
 /*--------------------------------------------------------------------
- * Insert/Remove from correct freelist
+ * Insert/Remove from the free tree
  */
 
 static void
 insfree(struct smf_sc *sc, struct smf *sp)
 {
-	size_t b;
-	struct smf *sp2;
-	size_t ns;
 
 	assert(sp->alloc == 0);
-	assert(sp->flist == NULL);
+	assert(sp->isfree == 0);
 	Lck_AssertHeld(&sc->mtx);
-	b = sp->size / sc->pagesize;
-	if (b >= NBUCKET) {
-		b = NBUCKET - 1;
+	if (sp->size / sc->pagesize >= SMALLPAGES)
 		sc->stats->g_smf_large++;
-	} else {
-		sc->stats->g_smf_frag++;
-	}
-	sp->flist = &sc->free[b];
-	ns = b * sc->pagesize;
-	VTAILQ_FOREACH(sp2, sp->flist, status) {
-		assert(sp2->size >= ns);
-		assert(sp2->alloc == 0);
-		assert(sp2->flist == sp->flist);
-		if (sp->offset < sp2->offset)
-			break;
-	}
-	if (sp2 == NULL)
-		VTAILQ_INSERT_TAIL(sp->flist, sp, status);
 	else
-		VTAILQ_INSERT_BEFORE(sp2, sp, status);
+		sc->stats->g_smf_frag++;
+	AZ(VRB_INSERT(smf_freetree, &sc->free, sp));
+	sp->isfree = 1;
 }
 
 static void
-remfree(const struct smf_sc *sc, struct smf *sp)
+remfree(struct smf_sc *sc, struct smf *sp)
 {
-	size_t b;
 
 	assert(sp->alloc == 0);
-	assert(sp->flist != NULL);
+	assert(sp->isfree != 0);
 	Lck_AssertHeld(&sc->mtx);
-	b = sp->size / sc->pagesize;
-	if (b >= NBUCKET) {
-		b = NBUCKET - 1;
+	if (sp->size / sc->pagesize >= SMALLPAGES)
 		sc->stats->g_smf_large--;
-	} else {
+	else
 		sc->stats->g_smf_frag--;
-	}
-	assert(sp->flist == &sc->free[b]);
-	VTAILQ_REMOVE(sp->flist, sp, status);
-	sp->flist = NULL;
+	AN(VRB_REMOVE(smf_freetree, &sc->free, sp));
+	sp->isfree = 0;
 }
 
 /*--------------------------------------------------------------------
- * Allocate a range from the first free range that is large enough.
+ * Allocate a range from the smallest free range that is large enough.
  */
 
 static struct smf *
 alloc_smf(struct smf_sc *sc, size_t bytes)
 {
-	struct smf *sp, *sp2;
-	size_t b;
+	struct smf *sp, *sp2, key;
 
 	assert(!(bytes % sc->pagesize));
-	b = bytes / sc->pagesize;
-	if (b >= NBUCKET)
-		b = NBUCKET - 1;
-	sp = NULL;
-	for (; b < NBUCKET - 1; b++) {
-		sp = VTAILQ_FIRST(&sc->free[b]);
-		if (sp != NULL)
-			break;
-	}
-	if (sp == NULL) {
-		VTAILQ_FOREACH(sp, &sc->free[NBUCKET -1], status)
-			if (sp->size >= bytes)
-				break;
-	}
+	key.size = bytes;
+	key.offset = 0;
+	sp = VRB_NFIND(smf_freetree, &sc->free, &key);
 	if (sp == NULL)
 		return (sp);
 
@@ -269,8 +297,8 @@ alloc_smf(struct smf_sc *sc, size_t bytes)
 }
 
 /*--------------------------------------------------------------------
- * Free a range.  Attempt merge forward and backward, then sort into
- * free list according to age.
+ * Free a range.  Attempt merge forward and backward, then insert into
+ * the free tree.
  */
 
 static void
@@ -406,6 +434,13 @@ smf_open_chunk(struct smf_sc *sc, off_t sz, off_t off, off_t *fail, off_t *sum)
 		    MAP_NOCORE | MAP_NOSYNC | MAP_SHARED, sc->fd, off);
 		if (p != MAP_FAILED) {
 			(void) madvise(p, sz, MADV_RANDOM);
+			if (sc->hugetlbfs)
+				sc->stats->g_hugetlb += sz;
+#ifdef MADV_HUGEPAGE
+			else if (sc->hugepage &&
+			    !madvise(p, sz, MADV_HUGEPAGE))
+				sc->stats->g_thp_advised += sz;
+#endif
 			(*sum) += sz;
 			new_smf(sc, p, off, sz);
 			return;
@@ -434,6 +469,8 @@ smf_open(const struct stevedore *st)
 	CAST_OBJ_NOTNULL(sc, st->priv, SMF_SC_MAGIC);
 	sc->stats = VSM_Alloc(sizeof *sc->stats,
 	    VSC_CLASS, VSC_type_smf, st->ident);
+	sc->stevedore = st;
+	VTAILQ_INSERT_TAIL(&smf_scs, sc, list);
 	Lck_New(&sc->mtx, lck_smf);
 	Lck_Lock(&sc->mtx);
 	smf_open_chunk(sc, sc->filesize, 0, &fail, &sum);
@@ -538,6 +575,38 @@ smf_free(struct storage *s)
 	Lck_Unlock(&sc->mtx);
 }
 
+/*--------------------------------------------------------------------
+ * The mapping is MADV_RANDOM, so a page missing from the page cache
+ * costs the delivering worker one synchronous read per page.  Ask the
+ * kernel to start reading in the whole segment instead, this returns
+ * as soon as the reads are queued.
+ */
+
+static void __match_proto__(storage_prefetch_f)
+smf_prefetch(const struct storage *s)
+{
+	struct smf *smf;
+	struct smf_sc *sc;
+
+	CHECK_OBJ_NOTNULL(s, STORAGE_MAGIC);
+	CAST_OBJ_NOTNULL(smf, s->priv, SMF_MAGIC);
+	sc = smf->sc;
+#ifdef POSIX_FADV_WILLNEED
+	(void)posix_fadvise(sc->fd, smf->offset, smf->size,
+	    POSIX_FADV_WILLNEED);
+#else
+	(void)madvise(smf->ptr, smf->size, MADV_WILLNEED);
+#endif
+#ifndef HAVE_SYNC_ATOMICS64
+	Lck_Lock(&sc->mtx);
+#endif
+	STV_ADD(&sc->stats->c_prefetch, 1);
+	STV_ADD(&sc->stats->c_prefetch_bytes, smf->size);
+#ifndef HAVE_SYNC_ATOMICS64
+	Lck_Unlock(&sc->mtx);
+#endif
+}
+
 /*--------------------------------------------------------------------*/
 
 const struct stevedore smf_stevedore = {
@@ -548,69 +617,221 @@ const struct stevedore smf_stevedore = {
 	.alloc	=	smf_alloc,
 	.trim	=	smf_trim,
 	.free	=	smf_free,
+	.prefetch =	smf_prefetch,
 };
 
-#ifdef INCLUDE_TEST_DRIVER
+/*--------------------------------------------------------------------
+ * Report how the free space is chopped up.
+ */
 
-void vca_flush(struct sess *sp) {}
+static void
+smf_report(struct cli *cli, struct smf_sc *sc)
+{
+	struct smf *sp;
+	uintmax_t nfree, bfree, large, bused, nused;
+	uintmax_t hist_n[NHIST], hist_b[NHIST];
+	size_t pages;
+	int i;
 
-#define N	100
-#define M	(128*1024)
+	memset(hist_n, 0, sizeof hist_n);
+	memset(hist_b, 0, sizeof hist_b);
+	nfree = bfree = 0;
 
-struct storage *s[N];
+	Lck_Lock(&sc->mtx);
+	VRB_FOREACH(sp, smf_freetree, &sc->free) {
+		nfree++;
+		bfree += sp->size;
+		pages = sp->size / sc->pagesize;
+		for (i = 0; i < NHIST - 1 && pages > 1; i++)
+			pages >>= 1;
+		hist_n[i]++;
+		hist_b[i] += sp->size;
+	}
+	sp = VRB_MAX(smf_freetree, &sc->free);
+	large = (sp == NULL ? 0 : sp->size);
+	nused = sc->stats->g_alloc;
+	bused = sc->stats->g_bytes;
+	Lck_Unlock(&sc->mtx);
+
+	VCLI_Out(cli, "Stevedore: %s (%s)\n",
+	    sc->stevedore->ident, sc->filename);
+	VCLI_Out(cli, "  Size: %ju, page %u\n", sc->filesize, sc->pagesize);
+	VCLI_Out(cli, "  Used: %ju bytes in %ju ranges\n", bused, nused);
+	VCLI_Out(cli, "  Free: %ju bytes in %ju ranges\n", bfree, nfree);
+	VCLI_Out(cli, "  Largest free: %ju bytes\n", large);
+	VCLI_Out(cli, "  Fragmentation: %.2f%%\n",
+	    bfree == 0 ? 0. : 100. * (1. - (double)large / bfree));
+	VCLI_Out(cli, "  %12s %12s %16s\n", "pages", "ranges", "bytes");
+	for (i = 0; i < NHIST; i++) {
+		if (hist_n[i] == 0)
+			continue;
+		VCLI_Out(cli, "  %11ju%s %12ju %16ju\n", (uintmax_t)1 << i,
+		    i == NHIST - 1 ? "+" : " ", hist_n[i], hist_b[i]);
+	}
+}
 
 static void
-dumpit(void)
+debug_smf_frag(struct cli *cli, const char * const *av, void *priv)
 {
-	struct smf_sc *sc = smf_stevedore.priv;
-	struct smf *s;
+	struct smf_sc *sc;
 
-	return (0);
-	printf("----------------\n");
-	printf("Order:\n");
-	VTAILQ_FOREACH(s, &sc->order, order) {
-		printf("%10p %12ju %12ju %12ju\n",
-		    s, s->offset, s->size, s->offset + s->size);
-	}
-	printf("Used:\n");
-	VTAILQ_FOREACH(s, &sc->used, status) {
-		printf("%10p %12ju %12ju %12ju\n",
-		    s, s->offset, s->size, s->offset + s->size);
+	(void)priv;
+	VTAILQ_FOREACH(sc, &smf_scs, list) {
+		if (av[2] != NULL && strcmp(av[2], sc->stevedore->ident))
+			continue;
+		smf_report(cli, sc);
+		if (av[2] != NULL)
+			return;
 	}
-	printf("Free:\n");
-	VTAILQ_FOREACH(s, &sc->free, status) {
-		printf("%10p %12ju %12ju %12ju\n",
-		    s, s->offset, s->size, s->offset + s->size);
+	if (av[2] != NULL) {
+		VCLI_Out(cli, "Stevedore <%s> not found\n", av[2]);
+		VCLI_SetResult(cli, CLIS_PARAM);
 	}
-	printf("================\n");
+}
+
+static struct cli_proto debug_cmds[] = {
+	{ "debug.smf_frag", "debug.smf_frag [stevedore]",
+		"\tReport free space fragmentation of file stevedores.\n"
+		"\tFree ranges are counted by size in pages, rounded down\n"
+		"\tto a power of two.\n",
+		0, 1, "d", debug_smf_frag },
+	{ NULL }
+};
+
+void
+SMF_Init(void)
+{
+
+	CLI_AddFuncs(debug_cmds);
+}
+
+/*--------------------------------------------------------------------
+ * Benchmark the allocator on a file, with random alloc/trim/free
+ * traffic on a fixed number of slots.  Build from this directory with:
+ *
+ *	cc -O2 -DINCLUDE_TEST_DRIVER -I../../.. -I../../../include -I.. \
+ *	    storage_file.c -L../../../lib/libvarnish/.libs -lvarnish \
+ *	    -lm -lpthread -lrt -o smf_bench
+ *
+ *	./smf_bench [file-size [slots [operations]]]
+ */
+
+#ifdef INCLUDE_TEST_DRIVER
+
+#include <sys/stat.h>
+
+#include <fcntl.h>
+#include <stdarg.h>
+#include <unistd.h>
+
+#include "vtim.h"
+
+struct VSC_C_lck *lck_smf;
+
+void Lck__Lock(struct lock *lck, const char *p, const char *f, int l)
+{ (void)lck; (void)p; (void)f; (void)l; }
+void Lck__Unlock(struct lock *lck, const char *p, const char *f, int l)
+{ (void)lck; (void)p; (void)f; (void)l; }
+void Lck__New(struct lock *lck, struct VSC_C_lck *v, const char *w)
+{ (void)lck; (void)v; (void)w; }
+void Lck__Assert(const struct lock *lck, int held)
+{ (void)lck; (void)held; }
+
+void *
+VSM_Alloc(unsigned size, const char *class, const char *type,
+    const char *ident)
+{
+	(void)class; (void)type; (void)ident;
+	return (calloc(size, 1));
+}
+
+void
+VCLI_Out(struct cli *cli, const char *fmt, ...)
+{
+	va_list ap;
+
+	(void)cli;
+	va_start(ap, fmt);
+	(void)vprintf(fmt, ap);
+	va_end(ap);
+}
+
+void VCLI_SetResult(struct cli *cli, unsigned r) { (void)cli; (void)r; }
+void CLI_AddFuncs(struct cli_proto *p) { (void)p; }
+void mgt_child_inherit(int fd, const char *what) { (void)fd; (void)what; }
+
+int
+STV_GetFile(const char *fn, int *fdp, const char **fnp, const char *ctx)
+{
+	(void)fn; (void)fdp; (void)fnp; (void)ctx;
+	abort();
+}
+
+uintmax_t
+STV_FileSize(int fd, const char *size, unsigned *granularity,
+    const char *ctx)
+{
+	(void)fd; (void)size; (void)granularity; (void)ctx;
+	abort();
 }
 
 int
 main(int argc, char **argv)
 {
-	int i, j;
+	static struct stevedore st;
+	struct storage **s;
+	struct smf_sc *sc;
+	char fn[] = "/tmp/smf_bench.XXXXXX";
+	unsigned n, i, ops, nop, nfail;
+	size_t j, m;
+	double t0, t1;
 
 	setbuf(stdout, NULL);
-	smf_init(&smf_stevedore, "");
-	smf_open(&smf_stevedore);
-	while (1) {
-		dumpit();
-		i = random() % N;
-		do
-			j = random() % M;
-		while (j == 0);
+	m = 128 * 1024;
+	n = argc > 2 ? strtoul(argv[2], NULL, 0) : 10000;
+	ops = argc > 3 ? strtoul(argv[3], NULL, 0) : 10000000;
+	s = calloc(n, sizeof *s);
+	AN(s);
+
+	ALLOC_OBJ(sc, SMF_SC_MAGIC);
+	AN(sc);
+	VTAILQ_INIT(&sc->order);
+	VRB_INIT(&sc->free);
+	VTAILQ_INIT(&sc->used);
+	sc->pagesize = getpagesize();
+	sc->filename = fn;
+	sc->filesize = argc > 1 ? strtoull(argv[1], NULL, 0) : 1UL << 30;
+	sc->fd = mkstemp(fn);
+	assert(sc->fd >= 0);
+	AZ(unlink(fn));
+	AZ(ftruncate(sc->fd, (off_t)sc->filesize));
+
+	st = smf_stevedore;
+	bprintf(st.ident, "%s", "bench");
+	st.priv = sc;
+	smf_open(&st);
+
+	nfail = 0;
+	t0 = VTIM_mono();
+	for (nop = 0; nop < ops; nop++) {
+		i = random() % n;
+		j = 1 + random() % m;
 		if (s[i] == NULL) {
-			s[i] = smf_alloc(&smf_stevedore, j);
-			printf("A %10p %12d\n", s[i], j);
+			s[i] = smf_alloc(&st, j);
+			if (s[i] == NULL)
+				nfail++;
 		} else if (j < s[i]->space) {
-			smf_trim(s[i], j);
-			printf("T %10p %12d\n", s[i], j);
+			smf_trim(s[i], j, 1);
 		} else {
 			smf_free(s[i]);
-			printf("D %10p\n", s[i]);
 			s[i] = NULL;
 		}
 	}
+	t1 = VTIM_mono();
+	printf("%u ops on %u slots in %.3f s, %.1f ns/op, %u failed\n",
+	    ops, n, t1 - t0, 1e9 * (t1 - t0) / ops, nfail);
+	smf_report(NULL, sc);
+	return (0);
 }
 
 #endif /* INCLUDE_TEST_DRIVER */
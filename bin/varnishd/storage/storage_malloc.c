@@ -27,25 +27,109 @@
  * SUCH DAMAGE.
  *
  * Storage method based on malloc(3)
+ *
+ * With the "slab" argument, allocations up to SMA_CLASS_MAX bytes are
+ * rounded up to one of SMA_NCLASS size classes, four per power of two,
+ * and served from SMA_SLAB_SIZE slabs carved out of mmap(2)'ed arenas.
+ * The struct storage of every item lives in the descriptor of its slab,
+ * so such an allocation costs neither a malloc(3) nor an ALLOC_OBJ.
+ *
+ * In front of the per class lists of partially used slabs, every CPU
+ * has a small cache of free items of each class.  A slab which gets
+ * all its items back goes to the arena for any class to use, and its
+ * pages go back to the kernel until then.
+ *
+ * Bigger allocations are malloc(3)'ed as before.  That includes the
+ * fetch_chunksize chunks for bodies of unknown length, which are
+ * usually trimmed a lot when the body ends, something a slab item
+ * can not be.
+ *
+ * The size limit counts the memory taken from the system: every slab
+ * from when it leaves the arena until all its items are back, and the
+ * bigger allocations by their size.  The items themselves are not
+ * counted against it, a slab is.
+ *
+ * The "hugepage" argument implies "slab" and puts the arenas on 2MB
+ * pages, the size of a slab, so a released slab still gives a whole
+ * page back.  We try the reserved huge page pool first, then align the
+ * arena and ask for transparent huge pages.
  */
 
 #include "config.h"
 
+#include <sys/mman.h>
+
+#include <sched.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <unistd.h>
 
 #include "cache/cache.h"
 #include "storage/storage.h"
 
 #include "vnum.h"
 
+#define SMA_CLASS_MIN_SHIFT	8
+#define SMA_CLASS_MIN		(1U << SMA_CLASS_MIN_SHIFT)
+#define SMA_CLASS_MAX_SHIFT	16
+#define SMA_CLASS_MAX		(1U << SMA_CLASS_MAX_SHIFT)
+#define SMA_NCLASS		\
+	((SMA_CLASS_MAX_SHIFT - SMA_CLASS_MIN_SHIFT) * 4 + 1)
+#define SMA_SLAB_SIZE		(2U << 20)
+#define SMA_ARENA_SIZE		(64U << 20)
+#define SMA_MAG_MAX		16
+#define SMA_MAXCPU		256
+
+#if defined(MAP_HUGETLB) && defined(MAP_HUGE_2MB)
+#  define SMA_MAP_HUGETLB	(MAP_HUGETLB | MAP_HUGE_2MB)
+#elif defined(MAP_HUGETLB)
+#  define SMA_MAP_HUGETLB	MAP_HUGETLB
+#endif
+
+struct sma_slab {
+	unsigned		magic;
+#define SMA_SLAB_MAGIC		0x5b3a01e7
+	unsigned		cls;
+	unsigned		nitem;
+	unsigned		nfree;
+	unsigned char		*base;
+	struct sma_sc		*sc;
+	VTAILQ_ENTRY(sma_slab)	list;
+	VTAILQ_HEAD(,storage)	free;
+	struct storage		st[];
+};
+
+struct sma_class {
+	unsigned		size;
+	unsigned		mag;	/* Per CPU cache depth */
+	VTAILQ_HEAD(,sma_slab)	partial;
+};
+
+struct sma_cpu {
+	struct lock		mtx;
+	unsigned		n[SMA_NCLASS];
+	struct storage		*item[SMA_NCLASS][SMA_MAG_MAX];
+};
+
 struct sma_sc {
 	unsigned		magic;
 #define SMA_SC_MAGIC		0x1ac8a345
-	struct lock		sma_mtx;
+	struct lock		sma_mtx;	/* Without atomics only */
 	size_t			sma_max;
 	size_t			sma_alloc;
 	struct VSC_C_sma	*stats;
+
+	/* Slab mode, the lists are protected by slab_mtx */
+	unsigned		slab;
+	unsigned		hugepage;
+	struct lock		slab_mtx;
+	struct sma_class	cls[SMA_NCLASS];
+	unsigned char		*arena;		/* Not yet carved */
+	size_t			arena_left;
+	size_t			arena_total;
+	unsigned char		*slab_free;	/* Linked through 1st word */
+	unsigned		ncpu;
+	struct sma_cpu		*cpu;
 };
 
 struct sma {
@@ -56,68 +140,463 @@ struct sma {
 	struct sma_sc		*sc;
 };
 
+/*--------------------------------------------------------------------
+ * Accounting
+ *
+ * Every fetch thread allocates and frees, so the size limit and the
+ * counters are kept with atomic operations where we have them, rather
+ * than under sma_mtx.  The counters of a single allocation are not
+ * updated as one, readers may see g_bytes and g_space disagree briefly.
+ *
+ * sma_alloc and g_space follow the size limit, so in slab mode they
+ * count whole slabs where g_bytes counts the items.
+ */
+
+/*
+ * Reserve size bytes under the limit, return zero if they do not fit.
+ * Racing reservations retry the compare-and-swap, and one of them
+ * always gets through.
+ */
+
+static int
+sma_reserve(struct sma_sc *sc, size_t size)
+{
+	size_t a;
+
+#ifdef HAVE_SYNC_ATOMICS64
+	do {
+		a = sc->sma_alloc;
+		if (a + size > sc->sma_max)
+			return (0);
+	} while (!__sync_bool_compare_and_swap(&sc->sma_alloc, a, a + size));
+	if (sc->sma_max != SIZE_MAX)
+		STV_ADD(&sc->stats->g_space, (uint64_t)-(int64_t)size);
+	return (1);
+#else
+	Lck_Lock(&sc->sma_mtx);
+	a = sc->sma_alloc;
+	if (a + size <= sc->sma_max) {
+		sc->sma_alloc += size;
+		if (sc->sma_max != SIZE_MAX)
+			sc->stats->g_space -= size;
+	}
+	Lck_Unlock(&sc->sma_mtx);
+	return (a + size <= sc->sma_max);
+#endif
+}
+
+static void
+sma_release(struct sma_sc *sc, size_t size)
+{
+
+#ifdef HAVE_SYNC_ATOMICS64
+	(void)__sync_fetch_and_sub(&sc->sma_alloc, size);
+	if (sc->sma_max != SIZE_MAX)
+		STV_ADD(&sc->stats->g_space, (uint64_t)size);
+#else
+	Lck_Lock(&sc->sma_mtx);
+	sc->sma_alloc -= size;
+	if (sc->sma_max != SIZE_MAX)
+		sc->stats->g_space += size;
+	Lck_Unlock(&sc->sma_mtx);
+#endif
+}
+
+/* Count nobj allocations of bytes bytes, or their release if negative */
+
+static void
+sma_acct(struct sma_sc *sc, int slab, int nobj, ssize_t bytes)
+{
+	struct VSC_C_sma *vsc;
+
+	vsc = sc->stats;
+#ifndef HAVE_SYNC_ATOMICS64
+	Lck_Lock(&sc->sma_mtx);
+#endif
+	if (bytes > 0)
+		STV_ADD(&vsc->c_bytes, (uint64_t)bytes);
+	else
+		STV_ADD(&vsc->c_freed, (uint64_t)-bytes);
+	/* The gauges go down by adding modulo 2^64 */
+	if (nobj != 0)
+		STV_ADD(&vsc->g_alloc, (uint64_t)(int64_t)nobj);
+	STV_ADD(&vsc->g_bytes, (uint64_t)(int64_t)bytes);
+	if (slab)
+		STV_ADD(&vsc->g_slab_bytes, (uint64_t)(int64_t)bytes);
+#ifndef HAVE_SYNC_ATOMICS64
+	Lck_Unlock(&sc->sma_mtx);
+#endif
+}
+
+static void
+sma_count(struct sma_sc *sc, volatile uint64_t *cnt)
+{
+
+#ifdef HAVE_SYNC_ATOMICS64
+	(void)sc;
+	STV_ADD(cnt, 1);
+#else
+	Lck_Lock(&sc->sma_mtx);
+	STV_ADD(cnt, 1);
+	Lck_Unlock(&sc->sma_mtx);
+#endif
+}
+
+/*--------------------------------------------------------------------
+ * Slab mode
+ */
+
+static unsigned
+sma_class(size_t size)
+{
+	unsigned b;
+
+	assert(size <= SMA_CLASS_MAX);
+	if (size <= SMA_CLASS_MIN)
+		return (0);
+	/* 2^b < size <= 2^(b+1) */
+	for (b = SMA_CLASS_MIN_SHIFT; ((size_t)2 << b) < size; b++)
+		continue;
+	return ((b - SMA_CLASS_MIN_SHIFT) * 4 +
+	    ((size - 1 - ((size_t)1 << b)) >> (b - 2)) + 1);
+}
+
+static struct sma_cpu *
+sma_cpu(const struct sma_sc *sc)
+{
+	uintptr_t u;
+
+#ifdef HAVE_SCHED_GETCPU
+	int i = sched_getcpu();
+
+	if (i >= 0)
+		return (&sc->cpu[i % sc->ncpu]);
+#endif
+	/* Different threads have different stacks */
+	u = (uintptr_t)&u >> 16;
+	return (&sc->cpu[u % sc->ncpu]);
+}
+
+/*
+ * Map a new arena, on huge pages if we are asked to and can.
+ */
+
+static unsigned char *
+sma_arena_map(struct sma_sc *sc, size_t sz)
+{
+	unsigned char *p, *a;
+	size_t l;
+
+	Lck_AssertHeld(&sc->slab_mtx);
+	if (!sc->hugepage) {
+		p = (void*)mmap(NULL, sz, PROT_READ|PROT_WRITE,
+		    MAP_PRIVATE|MAP_ANON, -1, 0);
+		return (p == MAP_FAILED ? NULL : p);
+	}
+#ifdef SMA_MAP_HUGETLB
+	p = (void*)mmap(NULL, sz, PROT_READ|PROT_WRITE,
+	    MAP_PRIVATE|MAP_ANON|SMA_MAP_HUGETLB, -1, 0);
+	if (p != MAP_FAILED) {
+		sc->stats->g_hugetlb += sz;
+		return (p);
+	}
+#endif
+	/* No reserved huge pages, map a slab extra and align to a slab */
+	l = sz + SMA_SLAB_SIZE;
+	p = (void*)mmap(NULL, l, PROT_READ|PROT_WRITE,
+	    MAP_PRIVATE|MAP_ANON, -1, 0);
+	if (p == MAP_FAILED)
+		return (NULL);
+	a = (void*)RUP2((uintptr_t)p, (uintptr_t)SMA_SLAB_SIZE);
+	if (a > p)
+		AZ(munmap(p, a - p));
+	if (a + sz < p + l)
+		AZ(munmap(a + sz, (p + l) - (a + sz)));
+#ifdef MADV_HUGEPAGE
+	if (madvise(a, sz, MADV_HUGEPAGE) == 0)
+		sc->stats->g_thp_advised += sz;
+#endif
+	return (a);
+}
+
+/*
+ * Get a slab worth of address space, from a slab released earlier or
+ * the current arena, mapping a new arena if needed.  The slab is
+ * counted against the size limit until sma_slab_put() empties it.
+ */
+
+static unsigned char *
+sma_slab_get(struct sma_sc *sc)
+{
+	unsigned char *p;
+	size_t sz;
+
+	Lck_AssertHeld(&sc->slab_mtx);
+	if (!sma_reserve(sc, SMA_SLAB_SIZE))
+		return (NULL);
+	if (sc->slab_free != NULL) {
+		p = sc->slab_free;
+		memcpy(&sc->slab_free, p, sizeof sc->slab_free);
+		return (p);
+	}
+	if (sc->arena_left == 0) {
+		sz = SMA_ARENA_SIZE;
+		if (sc->sma_max != SIZE_MAX) {
+			/* No more than the slabs can fill */
+			if (sc->arena_total >= sc->sma_max) {
+				sma_release(sc, SMA_SLAB_SIZE);
+				return (NULL);
+			}
+			if (sz > sc->sma_max - sc->arena_total)
+				sz = sc->sma_max - sc->arena_total;
+			sz = RUP2(sz, SMA_SLAB_SIZE);
+		}
+		p = sma_arena_map(sc, sz);
+		if (p == NULL) {
+			sma_release(sc, SMA_SLAB_SIZE);
+			return (NULL);
+		}
+		sc->arena = p;
+		sc->arena_left = sz;
+		sc->arena_total += sz;
+		sc->stats->g_arena = sc->arena_total;
+	}
+	assert(sc->arena_left >= SMA_SLAB_SIZE);
+	p = sc->arena;
+	sc->arena += SMA_SLAB_SIZE;
+	sc->arena_left -= SMA_SLAB_SIZE;
+	return (p);
+}
+
+static struct sma_slab *
+sma_slab_new(struct sma_sc *sc, unsigned cls)
+{
+	struct sma_slab *sl;
+	unsigned char *p;
+	unsigned u, n;
+
+	Lck_AssertHeld(&sc->slab_mtx);
+	p = sma_slab_get(sc);
+	if (p == NULL)
+		return (NULL);
+	n = SMA_SLAB_SIZE / sc->cls[cls].size;
+	sl = calloc(1, sizeof *sl + n * sizeof *sl->st);
+	if (sl == NULL) {
+		memcpy(p, &sc->slab_free, sizeof sc->slab_free);
+		sc->slab_free = p;
+		sma_release(sc, SMA_SLAB_SIZE);
+		return (NULL);
+	}
+	sl->magic = SMA_SLAB_MAGIC;
+	sl->cls = cls;
+	sl->nitem = sl->nfree = n;
+	sl->base = p;
+	sl->sc = sc;
+	VTAILQ_INIT(&sl->free);
+	for (u = 0; u < n; u++) {
+		sl->st[u].magic = STORAGE_MAGIC;
+		sl->st[u].priv = sl;
+		sl->st[u].ptr = p + u * sc->cls[cls].size;
+		sl->st[u].space = sc->cls[cls].size;
+		VTAILQ_INSERT_TAIL(&sl->free, &sl->st[u], list);
+	}
+	VTAILQ_INSERT_HEAD(&sc->cls[cls].partial, sl, list);
+	sc->stats->g_slab += SMA_SLAB_SIZE;
+	return (sl);
+}
+
+/* Return items to their slabs, and empty slabs to the arena */
+
+static void
+sma_slab_put(struct sma_sc *sc, struct storage **sp, unsigned n)
+{
+	struct sma_slab *sl;
+	struct storage *s;
+
+	Lck_AssertHeld(&sc->slab_mtx);
+	while (n-- > 0) {
+		s = sp[n];
+		CAST_OBJ_NOTNULL(sl, s->priv, SMA_SLAB_MAGIC);
+		if (sl->nfree++ == 0)
+			VTAILQ_INSERT_HEAD(&sc->cls[sl->cls].partial, sl, list);
+		VTAILQ_INSERT_HEAD(&sl->free, s, list);
+		if (sl->nfree < sl->nitem)
+			continue;
+		VTAILQ_REMOVE(&sc->cls[sl->cls].partial, sl, list);
+		/* Let the kernel have the pages until the slab is reused */
+		(void)madvise(sl->base, SMA_SLAB_SIZE, MADV_DONTNEED);
+		memcpy(sl->base, &sc->slab_free, sizeof sc->slab_free);
+		sc->slab_free = sl->base;
+		sc->stats->g_slab -= SMA_SLAB_SIZE;
+		sma_release(sc, SMA_SLAB_SIZE);
+		FREE_OBJ(sl);
+	}
+}
+
+/* Fill half the CPU cache from the slabs of the class */
+
+static void
+sma_slab_refill(struct sma_sc *sc, struct sma_cpu *cpu, unsigned cls)
+{
+	struct sma_class *cl;
+	struct sma_slab *sl;
+	struct storage *s;
+
+	cl = &sc->cls[cls];
+	Lck_Lock(&sc->slab_mtx);
+	sc->stats->c_slab_refill++;
+	while (cpu->n[cls] < (cl->mag + 1) / 2) {
+		sl = VTAILQ_FIRST(&cl->partial);
+		if (sl == NULL)
+			sl = sma_slab_new(sc, cls);
+		if (sl == NULL)
+			break;
+		CHECK_OBJ_NOTNULL(sl, SMA_SLAB_MAGIC);
+		s = VTAILQ_FIRST(&sl->free);
+		AN(s);
+		VTAILQ_REMOVE(&sl->free, s, list);
+		if (--sl->nfree == 0)
+			VTAILQ_REMOVE(&cl->partial, sl, list);
+		cpu->item[cls][cpu->n[cls]++] = s;
+	}
+	Lck_Unlock(&sc->slab_mtx);
+}
+
+/*
+ * Out of slabs: give back what the CPU caches hold, so empty slabs can
+ * go to other classes.
+ */
+
+static void
+sma_slab_drain(struct sma_sc *sc)
+{
+	struct sma_cpu *cpu;
+	unsigned u, c;
+
+	for (u = 0; u < sc->ncpu; u++) {
+		cpu = &sc->cpu[u];
+		Lck_Lock(&cpu->mtx);
+		Lck_Lock(&sc->slab_mtx);
+		for (c = 0; c < SMA_NCLASS; c++) {
+			sma_slab_put(sc, cpu->item[c], cpu->n[c]);
+			cpu->n[c] = 0;
+		}
+		Lck_Unlock(&sc->slab_mtx);
+		Lck_Unlock(&cpu->mtx);
+	}
+}
+
+static struct storage *
+sma_slab_alloc(struct sma_sc *sc, size_t size)
+{
+	struct sma_cpu *cpu;
+	struct storage *s = NULL;
+	unsigned cls, retry;
+
+	cls = sma_class(size);
+	for (retry = 0; s == NULL && retry < 2; retry++) {
+		if (retry)
+			sma_slab_drain(sc);
+		cpu = sma_cpu(sc);
+		Lck_Lock(&cpu->mtx);
+		if (cpu->n[cls] == 0)
+			sma_slab_refill(sc, cpu, cls);
+		if (cpu->n[cls] > 0)
+			s = cpu->item[cls][--cpu->n[cls]];
+		Lck_Unlock(&cpu->mtx);
+	}
+	if (s == NULL)
+		return (NULL);
+	CHECK_OBJ_NOTNULL(s, STORAGE_MAGIC);
+	assert(s->space == sc->cls[cls].size);
+	s->len = 0;
+	return (s);
+}
+
+static void
+sma_slab_free(struct sma_sc *sc, struct storage *s)
+{
+	struct sma_cpu *cpu;
+	struct sma_slab *sl;
+	unsigned cls, n;
+
+	CAST_OBJ_NOTNULL(sl, s->priv, SMA_SLAB_MAGIC);
+	cls = sl->cls;
+	cpu = sma_cpu(sc);
+	Lck_Lock(&cpu->mtx);
+	if (cpu->n[cls] == sc->cls[cls].mag) {
+		/* Full, give the oldest half back */
+		n = (cpu->n[cls] + 1) / 2;
+		Lck_Lock(&sc->slab_mtx);
+		sma_slab_put(sc, cpu->item[cls], n);
+		Lck_Unlock(&sc->slab_mtx);
+		memmove(cpu->item[cls], cpu->item[cls] + n,
+		    (cpu->n[cls] - n) * sizeof cpu->item[cls][0]);
+		cpu->n[cls] -= n;
+	}
+	cpu->item[cls][cpu->n[cls]++] = s;
+	Lck_Unlock(&cpu->mtx);
+}
+
+/*--------------------------------------------------------------------*/
+
 static struct storage *
 sma_alloc(struct stevedore *st, size_t size)
 {
 	struct sma_sc *sma_sc;
 	struct sma *sma = NULL;
+	struct storage *s = NULL;
+	unsigned slab;
 	void *p;
 
 	CAST_OBJ_NOTNULL(sma_sc, st->priv, SMA_SC_MAGIC);
-	Lck_Lock(&sma_sc->sma_mtx);
-	sma_sc->stats->c_req++;
-	if (sma_sc->sma_alloc + size > sma_sc->sma_max) {
-		sma_sc->stats->c_fail++;
-		size = 0;
-	} else {
-		sma_sc->sma_alloc += size;
-		sma_sc->stats->c_bytes += size;
-		sma_sc->stats->g_alloc++;
-		sma_sc->stats->g_bytes += size;
-		if (sma_sc->sma_max != SIZE_MAX)
-			sma_sc->stats->g_space -= size;
-	}
-	Lck_Unlock(&sma_sc->sma_mtx);
-
-	if (size == 0)
+	slab = sma_sc->slab && size <= SMA_CLASS_MAX;
+	if (slab)
+		size = sma_sc->cls[sma_class(size)].size;
+	sma_count(sma_sc, &sma_sc->stats->c_req);
+	if (!slab && !sma_reserve(sma_sc, size)) {
+		sma_count(sma_sc, &sma_sc->stats->c_fail);
 		return (NULL);
+	}
 
-	/*
-	 * Do not collaps the sma allocation with sma->s.ptr: it is not
-	 * a good idea.  Not only would it make ->trim impossible,
-	 * performance-wise it would be a catastropy with chunksized
-	 * allocations growing another full page, just to accomodate the sma.
-	 */
+	if (slab) {
+		/* Its slab is counted against the limit */
+		s = sma_slab_alloc(sma_sc, size);
+	} else {
+		/*
+		 * Do not collaps the sma allocation with sma->s.ptr: it is
+		 * not a good idea.  Not only would it make ->trim
+		 * impossible, performance-wise it would be a catastropy
+		 * with chunksized allocations growing another full page,
+		 * just to accomodate the sma.
+		 */
 
-	p = malloc(size);
-	if (p != NULL) {
-		ALLOC_OBJ(sma, SMA_MAGIC);
+		p = malloc(size);
+		if (p != NULL) {
+			ALLOC_OBJ(sma, SMA_MAGIC);
+			if (sma != NULL)
+				sma->s.ptr = p;
+			else
+				free(p);
+		}
 		if (sma != NULL)
-			sma->s.ptr = p;
-		else
-			free(p);
+			s = &sma->s;
 	}
-	if (sma == NULL) {
-		Lck_Lock(&sma_sc->sma_mtx);
-		/*
-		 * XXX: Not nice to have counters go backwards, but we do
-		 * XXX: Not want to pick up the lock twice just for stats.
-		 */
-		sma_sc->stats->c_fail++;
-		sma_sc->stats->c_bytes -= size;
-		sma_sc->stats->g_alloc--;
-		sma_sc->stats->g_bytes -= size;
-		if (sma_sc->sma_max != SIZE_MAX)
-			sma_sc->stats->g_space += size;
-		Lck_Unlock(&sma_sc->sma_mtx);
+	if (s == NULL) {
+		if (!slab)
+			sma_release(sma_sc, size);
+		sma_count(sma_sc, &sma_sc->stats->c_fail);
 		return (NULL);
 	}
+	sma_acct(sma_sc, slab, 1, size);
+	s->stevedore = st;
+	if (slab)
+		return (s);
 	sma->sc = sma_sc;
 	sma->sz = size;
 	sma->s.priv = sma;
 	sma->s.len = 0;
 	sma->s.space = size;
-	sma->s.stevedore = st;
 	sma->s.magic = STORAGE_MAGIC;
 	return (&sma->s);
 }
@@ -126,20 +605,23 @@ static void __match_proto__(storage_free_f)
 sma_free(struct storage *s)
 {
 	struct sma_sc *sma_sc;
+	struct sma_slab *sl;
 	struct sma *sma;
 
 	CHECK_OBJ_NOTNULL(s, STORAGE_MAGIC);
+	AN(s->priv);
+	if (*(unsigned *)s->priv == SMA_SLAB_MAGIC) {
+		CAST_OBJ_NOTNULL(sl, s->priv, SMA_SLAB_MAGIC);
+		sma_sc = sl->sc;
+		sma_acct(sma_sc, 1, -1, -(ssize_t)s->space);
+		sma_slab_free(sma_sc, s);
+		return;
+	}
 	CAST_OBJ_NOTNULL(sma, s->priv, SMA_MAGIC);
 	sma_sc = sma->sc;
 	assert(sma->sz == sma->s.space);
-	Lck_Lock(&sma_sc->sma_mtx);
-	sma_sc->sma_alloc -= sma->sz;
-	sma_sc->stats->g_alloc--;
-	sma_sc->stats->g_bytes -= sma->sz;
-	sma_sc->stats->c_freed += sma->sz;
-	if (sma_sc->sma_max != SIZE_MAX)
-		sma_sc->stats->g_space += sma->sz;
-	Lck_Unlock(&sma_sc->sma_mtx);
+	sma_acct(sma_sc, 0, -1, -(ssize_t)sma->sz);
+	sma_release(sma_sc, sma->sz);
 	free(sma->s.ptr);
 	free(sma);
 }
@@ -153,6 +635,10 @@ sma_trim(struct storage *s, size_t size, int move_ok)
 	size_t delta;
 
 	CHECK_OBJ_NOTNULL(s, STORAGE_MAGIC);
+	AN(s->priv);
+	/* Slab items can not shrink, they only lose to class rounding */
+	if (*(unsigned *)s->priv == SMA_SLAB_MAGIC)
+		return;
 	CAST_OBJ_NOTNULL(sma, s->priv, SMA_MAGIC);
 	sma_sc = sma->sc;
 
@@ -166,14 +652,9 @@ sma_trim(struct storage *s, size_t size, int move_ok)
 	if (delta < 256)
 		return;
 	if ((p = realloc(sma->s.ptr, size)) != NULL) {
-		Lck_Lock(&sma_sc->sma_mtx);
-		sma_sc->sma_alloc -= delta;
-		sma_sc->stats->g_bytes -= delta;
-		sma_sc->stats->c_freed += delta;
-		if (sma_sc->sma_max != SIZE_MAX)
-			sma_sc->stats->g_space += delta;
+		sma_acct(sma_sc, 0, 0, -(ssize_t)delta);
+		sma_release(sma_sc, delta);
 		sma->sz = size;
-		Lck_Unlock(&sma_sc->sma_mtx);
 		sma->s.ptr = p;
 		s->space = size;
 	}
@@ -203,6 +684,7 @@ sma_init(struct stevedore *parent, int ac, char * const *av)
 	const char *e;
 	uintmax_t u;
 	struct sma_sc *sc;
+	int i;
 
 	ASSERT_MGT();
 	ALLOC_OBJ(sc, SMA_SC_MAGIC);
@@ -212,9 +694,21 @@ sma_init(struct stevedore *parent, int ac, char * const *av)
 	parent->priv = sc;
 
 	AZ(av[ac]);
-	if (ac > 1)
+	if (ac > 3)
 		ARGV_ERR("(-smalloc) too many arguments\n");
 
+	for (i = 1; i < ac; i++) {
+		if (!strcmp(av[i], "slab")) {
+			sc->slab = 1;
+		} else if (!strcmp(av[i], "hugepage")) {
+			sc->slab = 1;
+			sc->hugepage = 1;
+		} else {
+			ARGV_ERR("(-smalloc) unknown argument \"%s\"\n",
+			    av[i]);
+		}
+	}
+
 	if (ac == 0 || *av[0] == '\0')
 		 return;
 
@@ -230,6 +724,46 @@ sma_init(struct stevedore *parent, int ac, char * const *av)
 	sc->sma_max = u;
 }
 
+static void
+sma_slab_open(struct sma_sc *sc)
+{
+	struct sma_class *cl;
+	unsigned u, b;
+	long l;
+
+	Lck_New(&sc->slab_mtx, lck_smaslab);
+	for (u = 0; u < SMA_NCLASS; u++) {
+		cl = &sc->cls[u];
+		if (u == 0) {
+			cl->size = SMA_CLASS_MIN;
+		} else {
+			b = SMA_CLASS_MIN_SHIFT + (u - 1) / 4;
+			cl->size = (1U << b) + ((u - 1) % 4 + 1) * (1U << (b - 2));
+		}
+		assert(sma_class(cl->size) == u);
+		assert(u == 0 || sma_class(cl[-1].size + 1) == u);
+		/* Do not let the CPU caches hoard more than 1/8 of a slab */
+		cl->mag = SMA_SLAB_SIZE / cl->size / 8;
+		if (cl->mag < 1)
+			cl->mag = 1;
+		if (cl->mag > SMA_MAG_MAX)
+			cl->mag = SMA_MAG_MAX;
+		VTAILQ_INIT(&cl->partial);
+	}
+	assert(sc->cls[SMA_NCLASS - 1].size == SMA_CLASS_MAX);
+
+	l = sysconf(_SC_NPROCESSORS_CONF);
+	if (l < 1)
+		l = 1;
+	if (l > SMA_MAXCPU)
+		l = SMA_MAXCPU;
+	sc->ncpu = l;
+	sc->cpu = calloc(sc->ncpu, sizeof *sc->cpu);
+	AN(sc->cpu);
+	for (u = 0; u < sc->ncpu; u++)
+		Lck_New(&sc->cpu[u].mtx, lck_smaslab);
+}
+
 static void
 sma_open(const struct stevedore *st)
 {
@@ -242,6 +776,8 @@ sma_open(const struct stevedore *st)
 	memset(sma_sc->stats, 0, sizeof *sma_sc->stats);
 	if (sma_sc->sma_max != SIZE_MAX)
 		sma_sc->stats->g_space = sma_sc->sma_max;
+	if (sma_sc->slab)
+		sma_slab_open(sma_sc);
 }
 
 const struct stevedore sma_stevedore = {
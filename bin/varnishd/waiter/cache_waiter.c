@@ -79,6 +79,91 @@ WAIT_Enter(struct sess *sp)
 	waiter->pass(waiter_priv, sp);
 }
 
+/*--------------------------------------------------------------------
+ * All idle sessions share the same timeout_idle, so keeping them ordered
+ * by t_idle makes finding the expired ones O(1) per session.  They come
+ * back from the workers almost in order, a few may have been lingering
+ * longer than others, so we look for their place from the tail.
+ */
+
+void
+WAIT_IdleInit(struct waitidle *wi)
+{
+
+	AN(wi);
+	wi->magic = WAITIDLE_MAGIC;
+	VTAILQ_INIT(&wi->head);
+}
+
+void
+WAIT_IdleAdd(struct waitidle *wi, struct sess *sp)
+{
+	struct sess *sp2;
+
+	CHECK_OBJ_NOTNULL(wi, WAITIDLE_MAGIC);
+	CHECK_OBJ_NOTNULL(sp, SESS_MAGIC);
+	sp2 = VTAILQ_LAST(&wi->head, waitidle_head);
+	while (sp2 != NULL && sp2->t_idle > sp->t_idle)
+		sp2 = VTAILQ_PREV(sp2, waitidle_head, list);
+	if (sp2 == NULL)
+		VTAILQ_INSERT_HEAD(&wi->head, sp, list);
+	else
+		VTAILQ_INSERT_AFTER(&wi->head, sp2, sp, list);
+}
+
+void
+WAIT_IdleDel(struct waitidle *wi, struct sess *sp)
+{
+
+	CHECK_OBJ_NOTNULL(wi, WAITIDLE_MAGIC);
+	CHECK_OBJ_NOTNULL(sp, SESS_MAGIC);
+	VTAILQ_REMOVE(&wi->head, sp, list);
+}
+
+/*
+ * Take the first session which has been idle for too long off the list.
+ */
+
+struct sess *
+WAIT_IdleExpired(struct waitidle *wi, double now)
+{
+	struct sess *sp;
+
+	CHECK_OBJ_NOTNULL(wi, WAITIDLE_MAGIC);
+	sp = VTAILQ_FIRST(&wi->head);
+	if (sp == NULL || sp->t_idle + cache_param->timeout_idle > now)
+		return (NULL);
+	CHECK_OBJ_NOTNULL(sp, SESS_MAGIC);
+	VTAILQ_REMOVE(&wi->head, sp, list);
+	return (sp);
+}
+
+/*
+ * How many milliseconds the waiter can sleep before the first session
+ * times out, -1 if there are none.  We never sleep longer than a second,
+ * so a reduction of timeout_idle takes effect reasonably soon.
+ */
+
+int
+WAIT_IdleTimeout(const struct waitidle *wi, double now)
+{
+	const struct sess *sp;
+	double d;
+
+	CHECK_OBJ_NOTNULL(wi, WAITIDLE_MAGIC);
+	sp = VTAILQ_FIRST(&wi->head);
+	if (sp == NULL)
+		return (-1);
+	d = sp->t_idle + cache_param->timeout_idle - now;
+	if (d <= 0.)
+		return (0);
+	if (d >= 1.)
+		return (1000);
+	return ((int)ceil(d * 1e3));
+}
+
+/*--------------------------------------------------------------------*/
+
 void
 WAIT_Write_Session(struct sess *sp, int fd)
 {
@@ -29,6 +29,11 @@
  * XXX: We need to pass sessions back into the event engine when they are
  * reused.  Not sure what the most efficient way is for that.  For now
  * write the session pointer to a pipe which the event engine monitors.
+ *
+ * To spread the load over more than one CPU, we can run several event
+ * engines (param: waiter_threads), each with its own epoll instance,
+ * thread, session list and pipe.  A session goes to the event engine
+ * picked by its file descriptor.
  */
 
 #include "config.h"
@@ -56,12 +61,18 @@ struct vwe {
 #define VWE_MAGIC		0x6bd73424
 
 	pthread_t		epoll_thread;
-	pthread_t		timer_thread;
 	int			epfd;
 
-	VTAILQ_HEAD(,sess)	sesshead;
+	struct waitidle		idle;
 	int			pipes[2];
-	int			timer_pipes[2];
+};
+
+struct vwe_set {
+	unsigned		magic;
+#define VWE_SET_MAGIC		0x1b6f0ad2
+
+	unsigned		nvwe;
+	struct vwe		*vwe;
 };
 
 static void
@@ -73,7 +84,7 @@ vwe_modadd(struct vwe *vwe, int fd, void *data, short arm)
 	 * XXX: will hang. See #644.
 	 */
 	assert(fd >= 0);
-	if (data == vwe->pipes || data == vwe->timer_pipes) {
+	if (data == vwe->pipes) {
 		struct epoll_event ev = {
 		    EPOLLIN | EPOLLPRI , { data }
 		};
@@ -119,7 +130,7 @@ vwe_eev(struct vwe *vwe, const struct epoll_event *ep, double now)
 			while (i >= sizeof ss[0]) {
 				CHECK_OBJ_NOTNULL(ss[j], SESS_MAGIC);
 				assert(ss[j]->fd >= 0);
-				VTAILQ_INSERT_TAIL(&vwe->sesshead, ss[j], list);
+				WAIT_IdleAdd(&vwe->idle, ss[j]);
 				vwe_cond_modadd(vwe, ss[j]->fd, ss[j]);
 				j++;
 				i -= sizeof ss[0];
@@ -129,16 +140,16 @@ vwe_eev(struct vwe *vwe, const struct epoll_event *ep, double now)
 	} else {
 		CAST_OBJ_NOTNULL(sp, ep->data.ptr, SESS_MAGIC);
 		if (ep->events & EPOLLIN || ep->events & EPOLLPRI) {
-			VTAILQ_REMOVE(&vwe->sesshead, sp, list);
+			WAIT_IdleDel(&vwe->idle, sp);
 			SES_Handle(sp, now);
 		} else if (ep->events & EPOLLERR) {
-			VTAILQ_REMOVE(&vwe->sesshead, sp, list);
+			WAIT_IdleDel(&vwe->idle, sp);
 			SES_Delete(sp, SC_REM_CLOSE, now);
 		} else if (ep->events & EPOLLHUP) {
-			VTAILQ_REMOVE(&vwe->sesshead, sp, list);
+			WAIT_IdleDel(&vwe->idle, sp);
 			SES_Delete(sp, SC_REM_CLOSE, now);
 		} else if (ep->events & EPOLLRDHUP) {
-			VTAILQ_REMOVE(&vwe->sesshead, sp, list);
+			WAIT_IdleDel(&vwe->idle, sp);
 			SES_Delete(sp, SC_REM_CLOSE, now);
 		}
 	}
@@ -151,9 +162,8 @@ vwe_thread(void *priv)
 {
 	struct epoll_event ev[NEEV], *ep;
 	struct sess *sp;
-	char junk;
-	double now, deadline;
-	int dotimer, i, n;
+	double now;
+	int i, n;
 	struct vwe *vwe;
 
 	CAST_OBJ_NOTNULL(vwe, priv, VWE_MAGIC);
@@ -164,33 +174,16 @@ vwe_thread(void *priv)
 	assert(vwe->epfd >= 0);
 
 	vwe_modadd(vwe, vwe->pipes[0], vwe->pipes, EPOLL_CTL_ADD);
-	vwe_modadd(vwe, vwe->timer_pipes[0], vwe->timer_pipes, EPOLL_CTL_ADD);
 
 	while (1) {
-		dotimer = 0;
-		n = epoll_wait(vwe->epfd, ev, NEEV, -1);
+		n = epoll_wait(vwe->epfd, ev, NEEV,
+		    WAIT_IdleTimeout(&vwe->idle, VTIM_real()));
 		now = VTIM_real();
-		for (ep = ev, i = 0; i < n; i++, ep++) {
-			if (ep->data.ptr == vwe->timer_pipes &&
-			    (ep->events == EPOLLIN || ep->events == EPOLLPRI))
-			{
-				assert(read(vwe->timer_pipes[0], &junk, 1));
-				dotimer = 1;
-			} else
-				vwe_eev(vwe, ep, now);
-		}
-		if (!dotimer)
-			continue;
+		for (ep = ev, i = 0; i < n; i++, ep++)
+			vwe_eev(vwe, ep, now);
 
 		/* check for timeouts */
-		deadline = now - cache_param->timeout_idle;
-		for (;;) {
-			sp = VTAILQ_FIRST(&vwe->sesshead);
-			if (sp == NULL)
-				break;
-			if (sp->t_idle > deadline)
-				break;
-			VTAILQ_REMOVE(&vwe->sesshead, sp, list);
+		while ((sp = WAIT_IdleExpired(&vwe->idle, now)) != NULL) {
 			// XXX: not yet VTCP_linger(sp->fd, 0);
 			SES_Delete(sp, SC_RX_TIMEOUT, now);
 		}
@@ -198,34 +191,21 @@ vwe_thread(void *priv)
 	return (NULL);
 }
 
-/*--------------------------------------------------------------------*/
-
-static void *
-vwe_timeout_idle_ticker(void *priv)
-{
-	char ticker = 'R';
-	struct vwe *vwe;
-
-	CAST_OBJ_NOTNULL(vwe, priv, VWE_MAGIC);
-	THR_SetName("cache-epoll-timeout_idle_ticker");
-
-	while (1) {
-		/* ticking */
-		assert(write(vwe->timer_pipes[1], &ticker, 1));
-		VTIM_sleep(100 * 1e-3);
-	}
-	return (NULL);
-}
 
 /*--------------------------------------------------------------------*/
 
 static void
 vwe_pass(void *priv, struct sess *sp)
 {
+	struct vwe_set *vws;
 	struct vwe *vwe;
 
-	CAST_OBJ_NOTNULL(vwe, priv, VWE_MAGIC);
+	CAST_OBJ_NOTNULL(vws, priv, VWE_SET_MAGIC);
+	CHECK_OBJ_NOTNULL(sp, SESS_MAGIC);
+	assert(sp->fd >= 0);
 
+	vwe = &vws->vwe[sp->fd % vws->nvwe];
+	CHECK_OBJ_NOTNULL(vwe, VWE_MAGIC);
 	WAIT_Write_Session(sp, vwe->pipes[1]);
 }
 
@@ -234,22 +214,29 @@ vwe_pass(void *priv, struct sess *sp)
 static void *
 vwe_init(void)
 {
+	struct vwe_set *vws;
 	struct vwe *vwe;
+	unsigned u;
 
-	ALLOC_OBJ(vwe, VWE_MAGIC);
-	AN(vwe);
-	VTAILQ_INIT(&vwe->sesshead);
-	AZ(pipe(vwe->pipes));
-	AZ(pipe(vwe->timer_pipes));
+	ALLOC_OBJ(vws, VWE_SET_MAGIC);
+	AN(vws);
+	vws->nvwe = cache_param->waiter_threads;
+	assert(vws->nvwe > 0);
+	vws->vwe = calloc(vws->nvwe, sizeof *vws->vwe);
+	AN(vws->vwe);
 
-	AZ(VFIL_nonblocking(vwe->pipes[0]));
-	AZ(VFIL_nonblocking(vwe->pipes[1]));
-	AZ(VFIL_nonblocking(vwe->timer_pipes[0]));
+	for (u = 0; u < vws->nvwe; u++) {
+		vwe = &vws->vwe[u];
+		vwe->magic = VWE_MAGIC;
+		WAIT_IdleInit(&vwe->idle);
+		AZ(pipe(vwe->pipes));
 
-	AZ(pthread_create(&vwe->timer_thread,
-	    NULL, vwe_timeout_idle_ticker, vwe));
-	AZ(pthread_create(&vwe->epoll_thread, NULL, vwe_thread, vwe));
-	return(vwe);
+		AZ(VFIL_nonblocking(vwe->pipes[0]));
+		AZ(VFIL_nonblocking(vwe->pipes[1]));
+
+		AZ(pthread_create(&vwe->epoll_thread, NULL, vwe_thread, vwe));
+	}
+	return(vws);
 }
 
 /*--------------------------------------------------------------------*/
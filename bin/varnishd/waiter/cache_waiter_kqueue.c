@@ -57,7 +57,7 @@ struct vwk {
 	int			kq;
 	struct kevent		ki[NKEV];
 	unsigned		nki;
-	VTAILQ_HEAD(,sess)	sesshead;
+	struct waitidle		idle;
 };
 
 /*--------------------------------------------------------------------*/
@@ -103,7 +103,7 @@ vwk_pipe_ev(struct vwk *vwk, const struct kevent *kp)
 	while (i >= sizeof ss[0]) {
 		CHECK_OBJ_NOTNULL(ss[j], SESS_MAGIC);
 		assert(ss[j]->fd >= 0);
-		VTAILQ_INSERT_TAIL(&vwk->sesshead, ss[j], list);
+		WAIT_IdleAdd(&vwk->idle, ss[j]);
 		vwk_kq_sess(vwk, ss[j], EV_ADD | EV_ONESHOT);
 		j++;
 		i -= sizeof ss[0];
@@ -126,11 +126,11 @@ vwk_sess_ev(struct vwk *vwk, const struct kevent *kp, double now)
 	    (kp->flags & EV_EOF) ? " EOF" : "");
 
 	if (kp->data > 0) {
-		VTAILQ_REMOVE(&vwk->sesshead, sp, list);
+		WAIT_IdleDel(&vwk->idle, sp);
 		SES_Handle(sp, now);
 		return;
 	} else if (kp->flags & EV_EOF) {
-		VTAILQ_REMOVE(&vwk->sesshead, sp, list);
+		WAIT_IdleDel(&vwk->idle, sp);
 		SES_Delete(sp, SC_REM_CLOSE, now);
 		return;
 	} else {
@@ -148,8 +148,9 @@ vwk_thread(void *priv)
 {
 	struct vwk *vwk;
 	struct kevent ke[NKEV], *kp;
-	int j, n, dotimer;
-	double now, deadline;
+	struct timespec ts, *tsp;
+	int j, n;
+	double now;
 	struct sess *sp;
 
 	CAST_OBJ_NOTNULL(vwk, priv, VWK_MAGIC);
@@ -159,23 +160,25 @@ vwk_thread(void *priv)
 	assert(vwk->kq >= 0);
 
 	j = 0;
-	EV_SET(&ke[j], 0, EVFILT_TIMER, EV_ADD, 0, 100, NULL);
-	j++;
 	EV_SET(&ke[j], vwk->pipes[0], EVFILT_READ, EV_ADD, 0, 0, vwk->pipes);
 	j++;
 	AZ(kevent(vwk->kq, ke, j, NULL, 0, NULL));
 
 	vwk->nki = 0;
 	while (1) {
-		dotimer = 0;
-		n = kevent(vwk->kq, vwk->ki, vwk->nki, ke, NKEV, NULL);
+		j = WAIT_IdleTimeout(&vwk->idle, VTIM_real());
+		if (j < 0) {
+			tsp = NULL;
+		} else {
+			ts = VTIM_timespec(j * 1e-3);
+			tsp = &ts;
+		}
+		n = kevent(vwk->kq, vwk->ki, vwk->nki, ke, NKEV, tsp);
 		now = VTIM_real();
-		assert(n >= 1 && n <= NKEV);
+		assert(n >= 0 && n <= NKEV);
 		vwk->nki = 0;
 		for (kp = ke, j = 0; j < n; j++, kp++) {
-			if (kp->filter == EVFILT_TIMER) {
-				dotimer = 1;
-			} else if (kp->filter == EVFILT_READ &&
+			if (kp->filter == EVFILT_READ &&
 			    kp->udata == vwk->pipes) {
 				vwk_pipe_ev(vwk, kp);
 			} else {
@@ -183,7 +186,7 @@ vwk_thread(void *priv)
 				vwk_sess_ev(vwk, kp, now);
 			}
 		}
-		if (!dotimer)
+		if (WAIT_IdleTimeout(&vwk->idle, now) != 0)
 			continue;
 		/*
 		 * Make sure we have no pending changes for the fd's
@@ -193,14 +196,7 @@ vwk_thread(void *priv)
 		 * would not know we meant "the old fd of this number".
 		 */
 		vwk_kq_flush(vwk);
-		deadline = now - cache_param->timeout_idle;
-		for (;;) {
-			sp = VTAILQ_FIRST(&vwk->sesshead);
-			if (sp == NULL)
-				break;
-			if (sp->t_idle > deadline)
-				break;
-			VTAILQ_REMOVE(&vwk->sesshead, sp, list);
+		while ((sp = WAIT_IdleExpired(&vwk->idle, now)) != NULL) {
 			// XXX: not yet (void)VTCP_linger(sp->fd, 0);
 			SES_Delete(sp, SC_RX_TIMEOUT, now);
 		}
@@ -229,7 +225,7 @@ vwk_init(void)
 	ALLOC_OBJ(vwk, VWK_MAGIC);
 	AN(vwk);
 
-	VTAILQ_INIT(&vwk->sesshead);
+	WAIT_IdleInit(&vwk->idle);
 	AZ(pipe(vwk->pipes));
 
 	AZ(VFIL_nonblocking(vwk->pipes[0]));
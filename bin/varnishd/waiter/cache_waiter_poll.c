@@ -51,7 +51,7 @@ struct vwp {
 	unsigned		npoll;
 	unsigned		hpoll;
 
-	VTAILQ_HEAD(,sess)	sesshead;
+	struct waitidle		idle;
 };
 
 /*--------------------------------------------------------------------*/
@@ -125,7 +125,7 @@ vwp_main(void *priv)
 	int v, v2;
 	struct vwp *vwp;
 	struct sess *ss[NEEV], *sp, *sp2;
-	double now, deadline;
+	double now;
 	int i, j, fd;
 
 	CAST_OBJ_NOTNULL(vwp, priv, VWP_MAGIC);
@@ -140,13 +140,13 @@ vwp_main(void *priv)
 		assert(vwp->pipes[0] <= vwp->hpoll);
 		assert(vwp->pollfd[vwp->pipes[0]].fd == vwp->pipes[0]);
 		assert(vwp->pollfd[vwp->pipes[1]].fd == -1);
-		v = poll(vwp->pollfd, vwp->hpoll + 1, 100);
+		v = poll(vwp->pollfd, vwp->hpoll + 1,
+		    WAIT_IdleTimeout(&vwp->idle, VTIM_real()));
 		assert(v >= 0);
 		now = VTIM_real();
-		deadline = now - cache_param->timeout_idle;
 		v2 = v;
-		VTAILQ_FOREACH_SAFE(sp, &vwp->sesshead, list, sp2) {
-			if (v != 0 && v2 == 0)
+		VTAILQ_FOREACH_SAFE(sp, &vwp->idle.head, list, sp2) {
+			if (v2 == 0)
 				break;
 			CHECK_OBJ_NOTNULL(sp, SESS_MAGIC);
 			fd = sp->fd;
@@ -157,14 +157,9 @@ vwp_main(void *priv)
 			if (vwp->pollfd[fd].revents) {
 				v2--;
 				vwp->pollfd[fd].revents = 0;
-				VTAILQ_REMOVE(&vwp->sesshead, sp, list);
+				WAIT_IdleDel(&vwp->idle, sp);
 				vwp_unpoll(vwp, fd);
 				SES_Handle(sp, now);
-			} else if (sp->t_idle <= deadline) {
-				VTAILQ_REMOVE(&vwp->sesshead, sp, list);
-				vwp_unpoll(vwp, fd);
-				// XXX: not yet (void)VTCP_linger(sp->fd, 0);
-				SES_Delete(sp, SC_RX_TIMEOUT, now);
 			}
 		}
 		if (v2 && vwp->pollfd[vwp->pipes[0]].revents) {
@@ -181,11 +176,18 @@ vwp_main(void *priv)
 			for (j = 0; j * sizeof ss[0] < i; j++) {
 				CHECK_OBJ_NOTNULL(ss[j], SESS_MAGIC);
 				assert(ss[j]->fd >= 0);
-				VTAILQ_INSERT_TAIL(&vwp->sesshead, ss[j], list);
+				WAIT_IdleAdd(&vwp->idle, ss[j]);
 				vwp_poll(vwp, ss[j]->fd);
 			}
 		}
 		assert(v2 == 0);
+
+		/* check for timeouts */
+		while ((sp = WAIT_IdleExpired(&vwp->idle, now)) != NULL) {
+			vwp_unpoll(vwp, sp->fd);
+			// XXX: not yet (void)VTCP_linger(sp->fd, 0);
+			SES_Delete(sp, SC_RX_TIMEOUT, now);
+		}
 	}
 	NEEDLESS_RETURN(NULL);
 }
@@ -211,7 +213,7 @@ vwp_poll_init(void)
 
 	ALLOC_OBJ(vwp, VWP_MAGIC);
 	AN(vwp);
-	VTAILQ_INIT(&vwp->sesshead);
+	WAIT_IdleInit(&vwp->idle);
 	AZ(pipe(vwp->pipes));
 
 	AZ(VFIL_nonblocking(vwp->pipes[1]));
@@ -52,7 +52,7 @@ struct vws {
 #define VWS_MAGIC		0x0b771473
 	pthread_t		ports_thread;
 	int			dport;
-	VTAILQ_HEAD(,sess)	sesshead;
+	struct waitidle		idle;
 };
 
 static inline void
@@ -77,7 +77,7 @@ vws_port_ev(struct vws *vws, port_event_t *ev, double now) {
 	if(ev->portev_source == PORT_SOURCE_USER) {
 		CAST_OBJ_NOTNULL(sp, ev->portev_user, SESS_MAGIC);
 		assert(sp->fd >= 0);
-		VTAILQ_INSERT_TAIL(&vws->sesshead, sp, list);
+		WAIT_IdleAdd(&vws->idle, sp);
 		vws_add(vws, sp->fd, sp);
 	} else {
 		assert(ev->portev_source == PORT_SOURCE_FD);
@@ -85,7 +85,7 @@ vws_port_ev(struct vws *vws, port_event_t *ev, double now) {
 		assert(sp->fd >= 0);
 		if(ev->portev_events & POLLERR) {
 			vws_del(vws, sp->fd);
-			VTAILQ_REMOVE(&vws->sesshead, sp, list);
+			WAIT_IdleDel(&vws->idle, sp);
 			SES_Delete(sp, SC_REM_CLOSE, now);
 			return;
 		}
@@ -104,7 +104,7 @@ vws_port_ev(struct vws *vws, port_event_t *ev, double now) {
 		 *          threadID=129476&tstart=0
 		 */
 		vws_del(vws, sp->fd);
-		VTAILQ_REMOVE(&vws->sesshead, sp, list);
+		WAIT_IdleDel(&vws->idle, sp);
 
 		/* SES_Handle will also handle errors */
 		SES_Handle(sp, now);
@@ -119,52 +119,27 @@ vws_thread(void *priv)
 	struct vws *vws;
 
 	CAST_OBJ_NOTNULL(vws, priv, VWS_MAGIC);
+
 	/*
-	 * timeouts:
-	 *
-	 * min_ts : Minimum timeout for port_getn
-	 * min_t  : ^ equivalent in floating point representation
-	 *
-	 * max_ts : Maximum timeout for port_getn
-	 * max_t  : ^ equivalent in floating point representation
-	 *
-	 * with (nevents == 1), we should always choose the correct port_getn
-	 * timeout to check session timeouts, so max is just a safety measure
-	 * (if this implementation is correct, it could be set to an "infinte"
-	 *  value)
-	 *
-	 * with (nevents > 1), min and max define the acceptable range for
-	 * - additional latency of keep-alive connections and
-	 * - additional tolerance for handling session timeouts
-	 *
+	 * The port_getn timeout is the time until the first idle session
+	 * times out, see WAIT_IdleTimeout()
 	 */
-	static struct timespec min_ts = {0L, 100L * 1000L * 1000L /*ns*/};
-	static double          min_t  = 0.1; /* 100    ms*/
-	static struct timespec max_ts = {1L, 0L};		/* 1 second */
-	static double	       max_t  = 1.0;			/* 1 second */
-
-	/* XXX: These should probably go in vws ? */
 	struct timespec ts;
 	struct timespec *timeout;
 
 	vws->dport = port_create();
 	assert(vws->dport >= 0);
 
-	timeout = &max_ts;
-
 	while (1) {
 		port_event_t ev[MAX_EVENTS];
 		u_int nevents;
 		int ei, ret;
-		double now, deadline;
+		double now;
 
 		/*
 		 * XXX Do we want to scale this up dynamically to increase
 		 *     efficiency in high throughput situations? - would need to
 		 *     start with one to keep latency low at any rate
-		 *
-		 *     Note: when increasing nevents, we must lower min_ts
-		 *	     and max_ts
 		 */
 		nevents = 1;
 
@@ -181,6 +156,13 @@ vws_thread(void *priv)
 		 *
 		 */
 
+		ei = WAIT_IdleTimeout(&vws->idle, VTIM_real());
+		if (ei < 0) {
+			timeout = NULL;
+		} else {
+			ts = VTIM_timespec(ei * 1e-3);
+			timeout = &ts;
+		}
 		ret = port_getn(vws->dport, ev, MAX_EVENTS, &nevents, timeout);
 		now = VTIM_real();
 
@@ -191,48 +173,12 @@ vws_thread(void *priv)
 			vws_port_ev(vws, ev + ei, now);
 
 		/* check for timeouts */
-		deadline = now - cache_param->timeout_idle;
-
-		/*
-		 * This loop assumes that the oldest sessions are always at the
-		 * beginning of the list (which is the case if we guarantee to
-		 * enqueue at the tail only
-		 *
-		 */
-
-		for (;;) {
-			sp = VTAILQ_FIRST(&vws->sesshead);
-			if (sp == NULL)
-				break;
-			if (sp->t_idle > deadline) {
-				break;
-			}
-			VTAILQ_REMOVE(&vws->sesshead, sp, list);
+		while ((sp = WAIT_IdleExpired(&vws->idle, now)) != NULL) {
 			if(sp->fd != -1) {
 				vws_del(vws, sp->fd);
 			}
 			SES_Delete(sp, SC_RX_TIMEOUT, now);
 		}
-
-		/*
-		 * Calculate the timeout for the next get_portn
-		 */
-
-		if (sp) {
-			double tmo =
-			    (sp->t_idle + cache_param->timeout_idle) - now;
-
-			if (tmo < min_t) {
-				timeout = &min_ts;
-			} else if (tmo > max_t) {
-				timeout = &max_ts;
-			} else {
-				ts = VTIM_timespec(tmo);
-				timeout = &ts;
-			}
-		} else {
-			timeout = &max_ts;
-		}
 	}
 	return(0);
 }
@@ -264,7 +210,7 @@ vws_init(void)
 
 	ALLOC_OBJ(vws, VWS_MAGIC);
 	AN(vws);
-	VTAILQ_INIT(&vws->sesshead);
+	WAIT_IdleInit(&vws->idle);
 	AZ(pthread_create(&vws->ports_thread, NULL, vws_thread, vws));
 	return (vws);
 }
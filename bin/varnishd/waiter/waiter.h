@@ -41,6 +41,24 @@ struct waiter {
 	waiter_pass_f		*pass;
 };
 
+/* cache_waiter.c */
+
+/*
+ * Idle sessions, ordered by when they time out.  Each waiter thread has
+ * its own and the waiter sleeps no longer than until the first of them.
+ */
+struct waitidle {
+	unsigned			magic;
+#define WAITIDLE_MAGIC			0x62a1f3c4
+	VTAILQ_HEAD(waitidle_head, sess)	head;
+};
+
+void WAIT_IdleInit(struct waitidle *wi);
+void WAIT_IdleAdd(struct waitidle *wi, struct sess *sp);
+void WAIT_IdleDel(struct waitidle *wi, struct sess *sp);
+struct sess *WAIT_IdleExpired(struct waitidle *wi, double now);
+int WAIT_IdleTimeout(const struct waitidle *wi, double now);
+
 /* mgt_waiter.c */
 extern struct waiter const * waiter;
 void WAIT_tweak_waiter(struct cli *cli, const char *arg);
@@ -31,10 +31,12 @@
 LOCK(sms)
 LOCK(smp)
 LOCK(sma)
+LOCK(smaslab)
 LOCK(smf)
 LOCK(hsl)
 LOCK(hcb)
 LOCK(hcl)
+LOCK(hbk)
 LOCK(vcl)
 LOCK(sessmem)
 LOCK(sess)
@@ -44,6 +44,18 @@ VSC_DO(MAIN, main, VSC_type_main)
 #include "tbl/vsc_f_main.h"
 VSC_DONE(MAIN, main, VSC_type_main)
 
+VSC_DO(EXP, exp, VSC_type_exp)
+#define VSC_DO_EXP
+#include "tbl/vsc_fields.h"
+#undef VSC_DO_EXP
+VSC_DONE(EXP, exp, VSC_type_exp)
+
+VSC_DO(LRU, lru, VSC_type_lru)
+#define VSC_DO_LRU
+#include "tbl/vsc_fields.h"
+#undef VSC_DO_LRU
+VSC_DONE(LRU, lru, VSC_type_lru)
+
 VSC_DO(SMA, sma, VSC_type_sma)
 #define VSC_DO_SMA
 #include "tbl/vsc_fields.h"
@@ -67,3 +79,9 @@ VSC_DO(MEMPOOL, mempool, VSC_type_mempool)
 #include "tbl/vsc_fields.h"
 #undef VSC_DO_MEMPOOL
 VSC_DONE(MEMPOOL, mempool, VSC_type_mempool)
+
+VSC_DO(POOL, pool, VSC_type_pool)
+#define VSC_DO_POOL
+#include "tbl/vsc_fields.h"
+#undef VSC_DO_POOL
+VSC_DONE(POOL, pool, VSC_type_pool)
@@ -284,6 +284,19 @@ VSC_F(thread_queue_len,		uint64_t, 0, 'g', info,
 	"  See also param queue_max."
 )
 
+VSC_F(thread_queue_stolen,	uint64_t, 1, 'c', info,
+    "Tasks stolen from other local queues",
+	"Number of times a worker thread took a task from another"
+	" local queue of its pool than its own."
+)
+
+VSC_F(thread_queue_overflow,	uint64_t, 0, 'c', info,
+    "Tasks queued on the overflow queue",
+	"Number of times a task was put on the shared queue of a pool"
+	" because the local queue it was assigned to was full, or"
+	" the shared queue was not empty yet."
+)
+
 VSC_F(busy_sleep,		uint64_t, 1, 'c', info,
     "Number of requests sent to sleep on busy objhdr",
 	"Number of requests sent to sleep without a worker threads because"
@@ -293,7 +306,21 @@ VSC_F(busy_sleep,		uint64_t, 1, 'c', info,
 VSC_F(busy_wakeup,		uint64_t, 1, 'c', info,
     "Number of requests woken after sleep on busy objhdr",
 	"Number of requests taken of the busy object sleep list and"
-	" and rescheduled."
+	" and rescheduled to repeat their lookup."
+)
+
+VSC_F(busy_coalesce,		uint64_t, 1, 'c', info,
+    "Number of requests handed the object after sleep on busy objhdr",
+	"Number of requests taken of the busy object sleep list with the"
+	" finished object already referenced, see the rush_coalesce"
+	" parameter."
+)
+
+VSC_F(busy_stream,		uint64_t, 1, 'c', info,
+    "Number of requests streaming a body being fetched",
+	"Number of requests which were delivered from an object while its"
+	" body was still being fetched, either directly or after a sleep"
+	" on the busy object sleep list."
 )
 
 VSC_F(sess_queued,		uint64_t, 0, 'c', info,
@@ -404,6 +431,12 @@ VSC_F(sess_herd,		uint64_t, 1, 'a', diag,
     "Session herd",
 	""
 )
+VSC_F(sess_rxscan,		uint64_t, 1, 'c', diag,
+    "Request header bytes scanned",
+	"Bytes looked at while searching for the end of the request"
+	" headers.  A header which arrives in many small pieces should"
+	" add little more than its own length."
+)
 
 /*--------------------------------------------------------------------*/
 
@@ -530,14 +563,19 @@ VSC_F(hcb_nolock,		uint64_t, 1, 'a', debug,
     "HCB Lookups without lock",
 	""
 )
-VSC_F(hcb_lock,			uint64_t, 0, 'a', debug,
+VSC_F(hcb_lock,			uint64_t, 1, 'a', debug,
     "HCB Lookups with lock",
 	""
 )
-VSC_F(hcb_insert,		uint64_t, 0, 'a', debug,
+VSC_F(hcb_insert,		uint64_t, 1, 'a', debug,
     "HCB Inserts",
 	""
 )
+VSC_F(hbk_resize,		uint64_t, 1, 'a', diag,
+    "Bucket hash resizes",
+	"Number of times a partition of the bucket hash has doubled"
+	" its number of buckets."
+)
 
 /*--------------------------------------------------------------------*/
 
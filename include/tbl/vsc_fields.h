@@ -113,6 +113,88 @@ VSC_F(locks,			uint64_t, 0, 'a', debug,
 
 #endif
 
+/**********************************************************************/
+
+#ifdef VSC_DO_EXP
+
+VSC_F(objects,			uint64_t, 0, 'g', diag,
+    "Objects on timer heap",
+	"Number of objects on the timer binheap of this expiry shard."
+)
+VSC_F(inserts,			uint64_t, 0, 'c', diag,
+    "Objects inserted",
+	"Count of objects inserted on the timer binheap of this shard."
+)
+VSC_F(rearms,			uint64_t, 0, 'c', debug,
+    "Timers rearmed",
+	"Count of objects moved on the timer binheap of this shard"
+	" because their ttl, grace or keep changed."
+)
+VSC_F(expired,			uint64_t, 0, 'c', diag,
+    "Objects expired",
+	"Count of objects removed from this shard by its expiry thread."
+)
+VSC_F(nuked,			uint64_t, 0, 'c', diag,
+    "Objects nuked",
+	"Count of objects removed from this shard by LRU eviction."
+)
+VSC_F(lag,			uint64_t, 0, 'g', diag,
+    "Expiry lag (msec)",
+	"How far behind the expiry thread of this shard is, measured as"
+	" the time since the object on the root of the timer heap should"
+	" have been expired, in milliseconds."
+	"  See also param expiry_batch."
+)
+
+#endif
+
+/**********************************************************************/
+
+#ifdef VSC_DO_LRU
+
+VSC_F(probation,		uint64_t, 0, 'g', diag,
+    "Objects on probation",
+	"Number of objects on the LRU which are not in the protected"
+	" segment.  With the classic policy this is all of them."
+)
+VSC_F(protected,		uint64_t, 0, 'g', diag,
+    "Objects protected",
+	"Number of objects in the protected segment of the LRU."
+	"  See also param lru_protected."
+)
+VSC_F(moved,			uint64_t, 0, 'c', diag,
+    "Objects moved",
+	"Count of referenced objects moved to the tail of their LRU"
+	" segment."
+)
+VSC_F(promoted,			uint64_t, 0, 'c', diag,
+    "Objects promoted",
+	"Count of referenced objects promoted from the probationary to"
+	" the protected segment."
+)
+VSC_F(demoted,			uint64_t, 0, 'c', diag,
+    "Objects demoted",
+	"Count of objects demoted from the protected to the probationary"
+	" segment, to keep the protected segment within its quota."
+)
+VSC_F(nuked,			uint64_t, 0, 'c', info,
+    "Objects nuked",
+	"Count of objects evicted from this LRU to make space."
+)
+VSC_F(admitted,			uint64_t, 0, 'c', diag,
+    "Objects admitted",
+	"Count of new objects which were more frequently requested"
+	" than the object evicted for them."
+)
+VSC_F(rejected,			uint64_t, 0, 'c', diag,
+    "Objects rejected",
+	"Count of new objects which were not more frequently requested"
+	" than the object evicted for them, and were put first in line"
+	" for eviction."
+)
+
+#endif
+
 /**********************************************************************
  * All Stevedores support these counters
  */
@@ -146,13 +228,44 @@ VSC_F(g_space,			uint64_t, 0, 'i', info,
     "Bytes available",
 	""
 )
+VSC_F(g_hugetlb,		uint64_t, 0, 'i', diag,
+    "Bytes on reserved huge pages",
+	"Bytes of storage mapped from the reserved huge page pool, or"
+	" from a file on hugetlbfs."
+)
+VSC_F(g_thp_advised,		uint64_t, 0, 'i', diag,
+    "Bytes advised for transparent huge pages",
+	"Bytes of storage the kernel was asked to back with transparent"
+	" huge pages.  Whether it did is shown by AnonHugePages and"
+	" ShmemHugePages in /proc/meminfo."
+)
 #endif
 
 
 /**********************************************************************/
 
 #ifdef VSC_DO_SMA
-/* No SMA specific counters */
+VSC_F(g_arena,			uint64_t, 0, 'i', diag,
+    "Bytes in slab arenas",
+	"Bytes of address space mapped for slabs.  Only used with the"
+	" slab argument."
+)
+VSC_F(g_slab,			uint64_t, 0, 'i', diag,
+    "Bytes in slabs",
+	"Bytes in slabs given to a size class.  This is the resident"
+	" memory of the slab allocator."
+)
+VSC_F(g_slab_bytes,		uint64_t, 0, 'i', diag,
+    "Bytes allocated from slabs",
+	"Bytes of slab items outstanding, rounded up to their size"
+	" class.  The difference to g_slab is lost to fragmentation and"
+	" the per CPU caches."
+)
+VSC_F(c_slab_refill,		uint64_t, 0, 'c', diag,
+    "Slab CPU cache refills",
+	"Count of times a per CPU cache of free slab items was empty and"
+	" had to be filled from the slabs."
+)
 #endif
 
 /**********************************************************************/
@@ -170,6 +283,15 @@ VSC_F(g_smf_large,		uint64_t, 0, 'i', info,
     "N large free smf",
 	""
 )
+VSC_F(c_prefetch,		uint64_t, 0, 'a', info,
+    "Prefetch requests",
+	"Number of storage segments we asked the kernel to read in"
+	" ahead of delivery."
+)
+VSC_F(c_prefetch_bytes,		uint64_t, 0, 'a', info,
+    "Bytes prefetched",
+	""
+)
 #endif
 
 /**********************************************************************/
@@ -234,5 +356,85 @@ VSC_F(randry,			uint64_t, 0, 'c', debug,
     "Pool ran dry",
 	""
 )
+VSC_F(mag_hit,			uint64_t, 0, 'c', debug,
+    "Magazine hits",
+	"Allocations served from the magazine of the thread, without"
+	" taking the pool lock."
+)
+VSC_F(mag_miss,			uint64_t, 0, 'c', debug,
+    "Magazine misses",
+	"Allocations which found the magazine of the thread empty, and"
+	" went to the pool."
+)
+
+#endif
+
+/**********************************************************************/
+#ifdef VSC_DO_POOL
+
+VSC_F(threads,			uint64_t, 0, 'g', info,
+    "Threads",
+	"Number of worker threads in this pool."
+)
+VSC_F(node,			uint64_t, 0, 'g', diag,
+    "NUMA node",
+	"NUMA node the threads of this pool are bound to."
+	"  See also param thread_pool_numa."
+)
+VSC_F(cpus,			uint64_t, 0, 'g', diag,
+    "CPUs bound",
+	"Number of CPUs the threads of this pool are bound to, zero if"
+	" they are not bound."
+)
+VSC_F(queue_len,		uint64_t, 0, 'g', info,
+    "Queue length",
+	"Number of tasks queued waiting for a thread."
+)
+VSC_F(arrivals,			uint64_t, 0, 'c', info,
+    "Tasks",
+	"Number of tasks scheduled on this pool."
+)
+VSC_F(spawned,			uint64_t, 0, 'c', diag,
+    "Threads spawned in batches",
+	"Number of threads the adaptive herder created from its estimate"
+	" of the queue wait."
+	"  See also param thread_queue_target."
+)
+VSC_F(rate,			uint64_t, 0, 'g', diag,
+    "Arrival rate",
+	"Tasks scheduled per second, as estimated by the adaptive herder."
+)
+VSC_F(wait_avg,			uint64_t, 0, 'g', diag,
+    "Queue wait (usec)",
+	"Average time queued tasks waited for a thread, as estimated by"
+	" the adaptive herder, in microseconds."
+)
+VSC_F(wait_100us,		uint64_t, 0, 'c', diag,
+    "Queue wait < 100us",
+	"Tasks which waited less than 100 microseconds for a thread,"
+	" including those handed directly to an idle thread."
+)
+VSC_F(wait_1ms,			uint64_t, 0, 'c', diag,
+    "Queue wait < 1ms",
+	"Tasks which waited between 100 microseconds and 1 millisecond"
+	" for a thread."
+)
+VSC_F(wait_10ms,		uint64_t, 0, 'c', diag,
+    "Queue wait < 10ms",
+	"Tasks which waited between 1 and 10 milliseconds for a thread."
+)
+VSC_F(wait_100ms,		uint64_t, 0, 'c', diag,
+    "Queue wait < 100ms",
+	"Tasks which waited between 10 and 100 milliseconds for a thread."
+)
+VSC_F(wait_1s,			uint64_t, 0, 'c', diag,
+    "Queue wait < 1s",
+	"Tasks which waited between 100 milliseconds and 1 second for a"
+	" thread."
+)
+VSC_F(wait_more,		uint64_t, 0, 'c', diag,
+    "Queue wait >= 1s",
+	"Tasks which waited a second or more for a thread."
+)
 
 #endif
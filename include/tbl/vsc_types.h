@@ -50,6 +50,15 @@ VSC_TYPE_F(mgt,		"MGT",		"MGT",		"Master",
 VSC_TYPE_F(mempool,	"MEMPOOL",	"MEMPOOL",	"Memory pool",
     "Memory pool counters"
 )
+VSC_TYPE_F(pool,	"POOL",		"POOL",		"Thread pool",
+    "Thread pool counters"
+)
+VSC_TYPE_F(exp,		"EXP",		"EXP",		"Expiry shard",
+    "Expiry shard counters"
+)
+VSC_TYPE_F(lru,		"LRU",		"LRU",		"LRU",
+    "LRU eviction policy counters"
+)
 VSC_TYPE_F(sma,		"SMA",		"SMA",		"Storage malloc",
     "Malloc storage counters"
 )
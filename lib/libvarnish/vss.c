@@ -193,8 +193,8 @@ VSS_resolve(const char *addr, const char *port, struct vss_addr ***vap)
  * avoid conflicts between INADDR_ANY and IN6ADDR_ANY.
  */
 
-int
-VSS_bind(const struct vss_addr *va)
+static int
+vss_bind(const struct vss_addr *va, int reuseport)
 {
 	int sd, val;
 
@@ -209,6 +209,21 @@ VSS_bind(const struct vss_addr *va)
 		(void)close(sd);
 		return (-1);
 	}
+	if (reuseport) {
+#ifdef SO_REUSEPORT
+		val = 1;
+		if (setsockopt(sd, SOL_SOCKET, SO_REUSEPORT,
+		    &val, sizeof val) != 0) {
+			perror("setsockopt(SO_REUSEPORT, 1)");
+			(void)close(sd);
+			return (-1);
+		}
+#else
+		(void)close(sd);
+		errno = ENOPROTOOPT;
+		return (-1);
+#endif
+	}
 #ifdef IPV6_V6ONLY
 	/* forcibly use separate sockets for IPv4 and IPv6 */
 	val = 1;
@@ -227,6 +242,25 @@ VSS_bind(const struct vss_addr *va)
 	return (sd);
 }
 
+int
+VSS_bind(const struct vss_addr *va)
+{
+
+	return (vss_bind(va, 0));
+}
+
+/*
+ * As VSS_bind(), but allow several sockets to be bound to the same
+ * address, the kernel spreads incoming connections over them.
+ */
+
+int
+VSS_bind_reuseport(const struct vss_addr *va)
+{
+
+	return (vss_bind(va, 1));
+}
+
 /*
  * Given a struct vss_addr, open a socket of the appropriate type, bind it
  * to the requested address, and start listening.